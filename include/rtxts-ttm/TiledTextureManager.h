@@ -19,6 +19,20 @@ namespace rtxts
 {
     static_assert(sizeof(size_t) == 8, "The hash function in TextureAndTileHash assumes 64-bit size_t");
 
+    // Read-only view of contiguous elements owned by the manager
+    template <typename T>
+    struct Span
+    {
+        const T* pData = nullptr;
+        size_t count = 0;
+
+        const T* begin() const { return pData; }
+        const T* end() const { return pData + count; }
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+        const T& operator[](size_t index) const { return pData[index]; }
+    };
+
     struct TileCoord
     {
         uint32_t x = 0;
@@ -42,6 +56,7 @@ namespace rtxts
         uint32_t packedTilesNum;         // number of tiles for packed mip levels
         uint32_t tileWidth;              // width of a tile in texels
         uint32_t tileHeight;             // height of a tile in texels
+        uint32_t poolId = 0;             // memory pool the tiles of the texture are accounted to
     };
 
     struct SamplerFeedbackDesc
@@ -51,16 +66,80 @@ namespace rtxts
         int32_t mipLevelBias = 0;
     };
 
+    // Policy for choosing the heap a new tile is allocated in
+    enum TilePlacementPolicy
+    {
+        TilePlacementPolicy_BestFit,  // Most occupied heap with a free tile first, concentrates tiles so other heaps drain and can be released
+        TilePlacementPolicy_FirstFit, // First heap with a free tile in the order heaps were added
+    };
+
+    // Expected lifetime of a tile, tiles of different classes are kept in separate heaps
+    enum TileLifetimeClass
+    {
+        TileLifetimeClass_Short, // Regular tiles of finer mip levels which are streamed in and out
+        TileLifetimeClass_Long,  // Packed tiles and the coarsest regular mip levels which live as long as their texture
+        TileLifetimeClass_Count
+    };
+
     // TiledTextureManager settings which are fixed after initialization
     struct TiledTextureManagerDesc
     {
         uint32_t heapTilesCapacity = 256; // number of 64KB tiles per heap, controls allocation granularity
+        uint32_t maxHeapTilesCapacity = 0; // when larger than heapTilesCapacity, desired heap capacities grow geometrically from heapTilesCapacity up to this size
+        TilePlacementPolicy tilePlacementPolicy = TilePlacementPolicy_BestFit;
+        bool textureAffinityPlacement = true; // place tiles next to their neighbors in the same heap when possible to produce contiguous mapping ranges, takes precedence over tilePlacementPolicy for heaps which are not empty
+        bool segregateTileLifetimes = true; // allocate long-lived and short-lived tiles in separate heaps so heaps with short-lived tiles can drain
+        uint32_t longLivedMipLevelsNum = 1; // number of the coarsest regular mip levels which are treated as long-lived, packed tiles are always long-lived
+
+        // Bounded mode for fixed-memory targets, 0 means no limit. Internal storage is allocated up front for the given limits,
+        // adding textures or heaps beyond them fails instead of growing and per-frame operations don't allocate memory
+        uint32_t maxTexturesNum = 0; // maximum number of textures
+        uint32_t maxTilesNum = 0;    // maximum number of tiles in all textures, including packed tiles
+        uint32_t maxHeapsNum = 0;    // maximum number of heaps including reserved heaps, preallocated with heapTilesCapacity tiles each
+    };
+
+    enum TiledTextureManagerResult
+    {
+        TiledTextureManagerResult_Ok,
+        TiledTextureManagerResult_TooManyTextures, // maxTexturesNum would be exceeded
+        TiledTextureManagerResult_TooManyTiles,    // maxTilesNum would be exceeded
+        TiledTextureManagerResult_TooManyHeaps,    // maxHeapsNum would be exceeded
     };
 
     // TiledTextureManager settings which can be changed at runtime
     struct TiledTextureManagerConfig
     {
         uint32_t numExtraStandbyTiles = 1000; // Target number of tiles to keep in standby before being evicted
+
+        // Heap demand prediction, the predictor advances once per sampler feedback timestamp
+        float heapDemandSmoothing = 0.2f;      // Weight of the newest sample in the smoothed heap demand
+        float heapDemandTrendSmoothing = 0.1f; // Weight of the newest sample in the smoothed heap demand trend
+        uint32_t heapGrowAheadSteps = 8;       // Number of updates the demand trend is extrapolated for grow-ahead recommendations
+        float heapGrowHysteresis = 0.05f;      // Recommend growing ahead only when the predicted demand exceeds the desired capacity by this fraction
+        float heapShrinkHysteresis = 0.1f;     // Shrink the desired capacity only when the demand falls below it by this fraction
+        float heapMinLifetime = 0.0f;          // Minimum time between a change of the desired capacity and a shrink, in timeStamp units
+    };
+
+    // Limits on the number of regular (unpacked) tiles a texture or a texture category can hold
+    struct TileQuota
+    {
+        uint32_t maxActiveTilesNum = UINT32_MAX;  // Maximum number of tiles holding a heap allocation (allocated, mapped or standby)
+        uint32_t maxStandbyTilesNum = UINT32_MAX; // Maximum number of tiles in standby
+    };
+
+    // Budget of a memory pool, pools share the heaps and borrow free tiles from each other
+    struct MemoryPoolDesc
+    {
+        uint32_t guaranteedTilesNum = 0;          // Tiles the pool can reclaim when heaps are full, by evicting standby tiles, then mapped tiles of pools holding more than their guarantee
+        uint32_t maxTilesNum = UINT32_MAX;        // Maximum number of tiles including borrowed ones, packed tiles are not limited
+        uint32_t maxStandbyTilesNum = UINT32_MAX; // Maximum number of tiles in standby
+    };
+
+    struct MemoryPoolStatistics
+    {
+        uint32_t allocatedTilesNum;  // Number of heap tiles held by tiles of the pool (allocated, mapped or standby), a deduplicated heap tile counts once for the pool of the tile holding it
+        uint32_t standbyTilesNum;    // Number of tiles in standby
+        uint32_t borrowedTilesNum;   // Number of allocated tiles over the guaranteed number of tiles
     };
 
     enum TextureTypes
@@ -108,20 +187,109 @@ namespace rtxts
     {
         uint32_t heapId = 0;
         uint32_t heapTileIndex = UINT32_MAX;
-        void* pHeap = nullptr;
 
         bool IsValid() const
         {
-            return pHeap != nullptr && heapTileIndex != UINT32_MAX;
+            return heapTileIndex != UINT32_MAX;
         }
     };
 
+    static_assert(sizeof(TileAllocation) == 8, "TileAllocation is stored per tile and should stay compact");
+
+    // Run of adjacent tiles in one row of a mip level, or of packed tiles, for batched tile mapping calls
+    struct TileRange
+    {
+        uint32_t tileIndex;        // index of the first tile, the tiles of a range have consecutive indices
+        uint32_t tilesNum;         // number of tiles in the range
+        TileCoord coord;           // coordinate of the first tile
+        TileAllocation allocation; // heap tile of the first tile, the following tiles use consecutive heap tiles. Invalid for ranges to unmap
+    };
+
+    enum TileBindingType
+    {
+        TileBindingType_Unbind,
+        TileBindingType_Bind,
+    };
+
+    // Record of the frame-level binding command stream, binds or unbinds a range of tiles of a texture.
+    // Maps directly onto a D3D12 tile region with its heap range, or onto a run of Vulkan sparse image binds
+    struct TileBinding
+    {
+        uint32_t textureId;
+        uint32_t tileIndex;     // index of the first tile, the tiles of a binding have consecutive indices
+        uint32_t tilesNum;      // number of tiles in the range
+        uint32_t x;             // coordinate of the first tile
+        uint32_t y;
+        uint8_t mipLevel;       // equals the number of regular mip levels for packed tiles
+        uint8_t type;           // TileBindingType
+        uint16_t padding;
+        uint32_t heapId;        // heap of bound tiles
+        uint32_t heapTileIndex; // heap tile of the first bound tile, the following tiles use consecutive heap tiles. UINT32_MAX for unbinds
+    };
+
+    static_assert(sizeof(TileBinding) == 32, "TileBinding is a packed record of the binding command stream");
+
+    // Move of a tile's content from one heap slot to another, executed by the application as a GPU copy followed by a remap of the tile
+    struct TileMove
+    {
+        uint32_t textureId;
+        uint32_t tileIndex;
+        TileAllocation srcAllocation;
+        TileAllocation dstAllocation;
+    };
+
     struct Statistics
     {
         uint32_t totalTilesNum;      // Total number of tiles tracked
-        uint32_t allocatedTilesNum;  // Number of allocated tiles
+        uint32_t allocatedTilesNum;  // Number of allocated tiles of this manager
         uint32_t standbyTilesNum;    // Number of tiles in the standby queue
-        uint32_t heapFreeTilesNum;   // Number of free tiles in allocated heaps
+        uint32_t heapFreeTilesNum;   // Number of free tiles in allocated heaps, shared with other managers using the same SharedTileAllocator
+        uint32_t sharedTilesNum;     // Number of allocated tiles using the heap tile of another tile with the same content
+    };
+
+    // Heap capacity recommendation of the heap demand predictor
+    struct HeapPlan
+    {
+        uint32_t demandTilesNum;     // Requested tiles + the standby count
+        uint32_t predictedTilesNum;  // Smoothed demand extrapolated by its trend over heapGrowAheadSteps updates
+        uint32_t desiredTilesNum;    // Capacity to keep, grows immediately with the demand and shrinks with hysteresis
+        uint32_t desiredHeapsNum;    // desiredTilesNum in heaps of heapTilesCapacity tiles
+        uint32_t growAheadTilesNum;  // Capacity worth adding on top of desiredTilesNum to hide heap creation latency
+        uint32_t growAheadHeapsNum;  // growAheadTilesNum in heaps of heapTilesCapacity tiles
+    };
+
+    struct HeapStatistics
+    {
+        uint32_t heapId;
+        uint32_t allocatedTilesNum;
+        uint32_t freeTilesNum;
+        TileLifetimeClass lifetimeClass; // Only meaningful for heaps with allocated tiles
+    };
+
+    struct LifetimeClassStatistics
+    {
+        uint32_t heapsNum;           // Number of non-empty heaps holding tiles of this class
+        uint32_t allocatedTilesNum;  // Number of tiles allocated in these heaps
+        uint32_t totalTilesNum;      // Capacity of these heaps
+    };
+
+    struct ExtendedStatistics
+    {
+        uint32_t heapsNum;           // Number of heaps added to the manager
+        uint32_t usedHeapsNum;       // Number of heaps with at least one allocated tile
+        uint32_t minHeapsNum;        // Minimum number of heaps which could hold all allocated tiles, using the largest heaps first
+        uint32_t releasableHeapsNum; // Number of heaps which could be released after a full defragmentation, reserved heaps and heaps being evacuated or trimmed are not counted
+        float fragmentation;         // usedHeapsNum / minHeapsNum, 1.0 when tiles are perfectly packed
+        LifetimeClassStatistics lifetimeClasses[TileLifetimeClass_Count];
+        std::vector<HeapStatistics> heaps; // Resized in place, reuse the same ExtendedStatistics across calls to avoid reallocating it
+    };
+
+    // Heaps which can be shared by several TiledTextureManager instances, e.g. one per world or streaming context.
+    // Free tiles and standby tiles are arbitrated between all managers attached to it.
+    class SharedTileAllocator
+    {
+    public:
+        virtual ~SharedTileAllocator() {};
     };
 
     class TiledTextureManager
@@ -133,11 +301,23 @@ namespace rtxts
         virtual void SetConfig(const TiledTextureManagerConfig& config) = 0;
 
         // Add a new texture to the manager
-        virtual void AddTiledTexture(const TiledTextureDesc& tiledTextureDesc, uint32_t& textureId) = 0;
+        virtual TiledTextureManagerResult AddTiledTexture(const TiledTextureDesc& tiledTextureDesc, uint32_t& textureId) = 0;
 
         // Remove a texture from the manager
         virtual void RemoveTiledTexture(uint32_t textureId) = 0;
 
+        // Assign a texture to a user-defined category which shares a tile quota, category 0 means no category
+        virtual void SetTextureCategory(uint32_t textureId, uint32_t categoryId) = 0;
+
+        // Set the tile quota of a single texture, tiles over the quota are evicted from the texture's own standby tiles first
+        virtual void SetTextureQuota(uint32_t textureId, const TileQuota& quota) = 0;
+
+        // Set the tile quota shared by all textures in a category
+        virtual void SetCategoryQuota(uint32_t categoryId, const TileQuota& quota) = 0;
+
+        // Set the budget of a memory pool, textures are assigned to a pool with TiledTextureDesc::poolId
+        virtual void SetMemoryPool(uint32_t poolId, const MemoryPoolDesc& memoryPoolDesc) = 0;
+
         // Computes the internal state of tile streaming requests using provided sampler feedback data
         // After this, call GetTilesToMap()
         virtual void UpdateWithSamplerFeedback(uint32_t textureId, SamplerFeedbackDesc& samplerFeedbackDesc, float timeStamp, float timeout) = 0;
@@ -147,43 +327,134 @@ namespace rtxts
         // as requested by this function.
         virtual void MatchPrimaryTexture(uint32_t primaryTextureId, uint32_t followerTextureId, float timeStamp, float timeout) = 0;
 
-        // After updating all textures, get the number of heaps desired to allocate all requested tiles + the standby count
+        // After updating all textures, get the number of heaps desired to allocate all requested tiles + the standby count, with shrink hysteresis applied
+        // NOTE: This assumes all heaps have heapTilesCapacity tiles, use GetDesiredHeapCapacities() with variable-size heaps
         virtual uint32_t GetNumDesiredHeaps() = 0;
 
-        // Add a new heap to the manager
-        virtual void AddHeap(uint32_t heapId) = 0;
+        // After updating all textures, get the desired heap capacity and the grow-ahead recommendation of the heap demand predictor
+        virtual HeapPlan GetHeapPlan() = 0;
 
-        // Remove a heap from the manager
+        // After updating all textures, get the capacities in tiles of the heaps which should be added to reach the desired capacity of GetHeapPlan()
+        // Capacities grow geometrically with the total heap capacity up to maxHeapTilesCapacity, the last one is the smallest size covering the remaining tiles
+        virtual void GetDesiredHeapCapacities(std::vector<uint32_t>& heapTilesNums) = 0;
+
+        // Add a new heap to the manager, a capacity of 0 uses heapTilesCapacity
+        virtual TiledTextureManagerResult AddHeap(uint32_t heapId, uint32_t heapTilesNum = 0) = 0;
+
+        // Remove a heap from the manager, tiles still allocated in the heap are unmapped and requested again
         virtual void RemoveHeap(uint32_t heapId) = 0;
 
+        // Reserve a heap which is still being created, e.g. on a background thread, a capacity of 0 uses heapTilesCapacity.
+        // Tiles are allocated in reserved heaps only when the other heaps are full, and are returned by GetTilesToMap() once the heap is committed.
+        // Call RemoveHeap() to cancel the reservation, tiles allocated in the heap are then requested again
+        virtual TiledTextureManagerResult ReserveHeap(uint32_t heapId, uint32_t heapTilesNum = 0) = 0;
+
+        // Commit a reserved heap once it has been created
+        virtual void CommitHeap(uint32_t heapId) = 0;
+
+        // Start moving all tiles of this manager out of a committed heap, no new tiles are allocated in the heap from now on.
+        // Tiles which hold data get a destination slot reserved in another heap and are returned as moves, tiles waiting to be mapped are reallocated directly.
+        // Once the moves are executed, call CompleteTileMoves(), the heap is then empty and can be removed.
+        // With a shared tile allocator, the heap only becomes empty once every manager with tiles in it has evacuated it.
+        // Returns false if some tiles could not get a destination, calling it again later only returns moves for those tiles.
+        virtual bool BeginEvacuateHeap(uint32_t heapId, std::vector<TileMove>& tileMoves) = 0;
+
+        // Abandon the evacuation of a heap, the heap accepts new tiles again and the moves out of it which were not completed are cancelled
+        virtual void CancelEvacuateHeap(uint32_t heapId) = 0;
+
+        // Updates internal state after the application copied the content of moved tiles and remapped them to their destination allocation
+        virtual void CompleteTileMoves(const std::vector<TileMove>& tileMoves) = 0;
+
         // Trim the standby tile allocation to the target
         virtual void TrimStandbyTiles() = 0;
 
+        // Limit the memory of allocated tiles, the desired heap capacity never exceeds the budget and tiles over it are not allocated.
+        // When the budget drops below the current heap capacity, call EmergencyTrim() to release heaps
+        virtual void SetMemoryBudget(uint64_t budgetInBytes) = 0;
+
+        // Free at least bytesToFree of heap memory within this frame, returning empty heaps which can be removed right away.
+        // Standby tiles in the released heaps are freed first. Only if that is not enough, other standby tiles and then the least recently requested mapped tiles are evicted.
+        // Tiles still needed in the released heaps are requested again
+        virtual void EmergencyTrim(uint64_t bytesToFree, std::vector<uint32_t>& heapIds) = 0;
+
         // Attempt to allocate all outstanding requested tiles
         virtual void AllocateRequestedTiles() = 0;
 
+        // Get the textures which have tiles to map or unmap sorted by id, only these have to be queried with the per-texture calls below
+        virtual void GetTexturesWithPendingWork(std::vector<uint32_t>& textureIds) = 0;
+
         // Get a list of tiles that need to be mapped and updated.
         // Once tiles are mapped by the application, UpdateTilesMapping() should be called to update internal state
         virtual void GetTilesToMap(uint32_t textureId, std::vector<uint32_t>& tileIndices) = 0;
 
         // Updates internal state of the texture after tiles are mapped
-        virtual void UpdateTilesMapping(uint32_t textureId, std::vector<uint32_t>& tileIndices) = 0;
+        virtual void UpdateTilesMapping(uint32_t textureId, const std::vector<uint32_t>& tileIndices) = 0;
+        virtual void UpdateTilesMapping(uint32_t textureId, Span<uint32_t> tileIndices) = 0;
 
-        // Get a list of tiles that are no longer requested and should be unmapped from the texture
+        // Get a list of tiles that are no longer requested and should be unmapped from the texture.
+        // Tiles freed and allocated again before the lists are retrieved are only returned by GetTilesToMap(), tiles freed before their mapping was retrieved are not returned at all
         virtual void GetTilesToUnmap(uint32_t textureId, std::vector<uint32_t>& tileIndices) = 0;
 
+        // Zero-copy alternatives to GetTilesToMap() and GetTilesToUnmap(). The pending lists are double-buffered, the view stays valid
+        // until the same call is made again for the texture or the texture is removed
+        virtual Span<uint32_t> GetTilesToMapSpan(uint32_t textureId) = 0;
+        virtual Span<uint32_t> GetTilesToUnmapSpan(uint32_t textureId) = 0;
+
+        // Alternative to GetTilesToMap() which coalesces the tiles into ranges mapped to consecutive heap tiles, sorted by heap and heap tile.
+        // Once the ranges are mapped by the application, UpdateTilesMapping() should be called with them
+        virtual void GetTileRangesToMap(uint32_t textureId, std::vector<TileRange>& tileRanges) = 0;
+
+        // Updates internal state of the texture after tile ranges are mapped, tiles whose allocation changed since the ranges were retrieved are skipped
+        virtual void UpdateTilesMapping(uint32_t textureId, const std::vector<TileRange>& tileRanges) = 0;
+
+        // Alternative to GetTilesToUnmap() which coalesces the tiles into ranges
+        virtual void GetTileRangesToUnmap(uint32_t textureId, std::vector<TileRange>& tileRanges) = 0;
+
+        // Alternative to the per-texture calls above which collects the tiles to unmap and map of all textures into one command stream.
+        // Bindings are sorted by texture, unbinds first and binds grouped by heap. The stream is double-buffered, it stays valid while the
+        // next frame is built and is overwritten by the call after next. Once the binds are executed, UpdateTilesMapping() should be called with the stream
+        virtual const std::vector<TileBinding>& BuildTileBindings() = 0;
+
+        // Updates internal state of the textures after the binds of a command stream are executed, tiles whose allocation changed since the stream was built are skipped
+        virtual void UpdateTilesMapping(const std::vector<TileBinding>& tileBindings) = 0;
+
         // Writes MinMip residency data to a mapped texture (uint8_t per tile)
         virtual void WriteMinMipData(uint32_t textureId, uint8_t* data) = 0;
 
         // Defragment up to a specified number of tiles (move them to a heap with free space on the "left" of their current heap)
+        // NOTE: Moved tiles are freed and requested again, which requires reloading their content
         virtual void DefragmentTiles(uint32_t numTiles) = 0;
 
-        // Get a list of empty heaps
+        // Defragment up to a specified number of tiles by moving them to a fuller heap while keeping them mapped.
+        // The application copies the tile content and remaps the tiles, then calls CompleteTileMoves()
+        virtual void DefragmentTiles(uint32_t numTiles, std::vector<TileMove>& tileMoves) = 0;
+
+        // Plan the tile moves which empty up to maxHeapsNum of the least occupied heaps using at most maxMovesNum moves.
+        // Only heaps whose tiles all fit in the free space of the other non-empty heaps are selected.
+        // Execute the moves and call CompleteTileMoves(), the emptied heaps are then returned by GetEmptyHeaps()
+        virtual void PlanDefragmentation(uint32_t maxHeapsNum, uint32_t maxMovesNum, std::vector<TileMove>& tileMoves) = 0;
+
+        // Get a list of empty heaps, sorted from the smallest to the largest capacity
         virtual void GetEmptyHeaps(std::vector<uint32_t>& emptyHeaps) = 0;
 
         // Get the description of a texture
         virtual TextureDesc GetTextureDesc(uint32_t textureId, TextureTypes textureType) const = 0;
 
+        // Set the content hash of a tile, e.g. from a pack index. Tiles of this manager with the same non-zero hash share one heap tile, which is freed once none of them holds it.
+        // Changing the hash of an allocated tile releases it, it is requested again if it is still needed
+        virtual void SetTileContentHash(uint32_t textureId, uint32_t tileIndex, uint64_t contentHash) = 0;
+
+        // Checks if a tile uses the heap tile of another tile with the same content, its data then doesn't have to be uploaded
+        virtual bool IsSharedTile(uint32_t textureId, uint32_t tileIndex) const = 0;
+
+        // Register a heap tile which the application prefilled with a constant value, e.g. one per format class. Its heap is not managed by the tile allocator.
+        // Tiles already using the constant tile are queued for mapping again when it changes
+        virtual void SetConstantTile(uint32_t constantTileId, const TileAllocation& tileAllocation) = 0;
+
+        // Flag a regular tile of a texture as holding a constant value, UINT32_MAX clears the flag. Constant tiles are mapped to the registered constant tile,
+        // they skip the requested queue and heap allocation and are unmapped instead of entering standby
+        virtual void SetTileConstant(uint32_t textureId, uint32_t tileIndex, uint32_t constantTileId) = 0;
+
         // Checks if a tile can currently be moved (for defragmentation)
         virtual bool IsMovableTile(uint32_t textureId, uint32_t tileIndex) const = 0;
 
@@ -195,7 +466,22 @@ namespace rtxts
 
         // Statistics
         virtual Statistics GetStatistics() const = 0;
+
+        // Heap occupancy and fragmentation statistics, cheap enough to query every frame
+        virtual void GetExtendedStatistics(ExtendedStatistics& statistics) const = 0;
+
+        // Tile usage of a memory pool
+        virtual MemoryPoolStatistics GetMemoryPoolStatistics(uint32_t poolId) const = 0;
     };
 
     TiledTextureManager* CreateTiledTextureManager(const TiledTextureManagerDesc& desc);
+
+    // Create a tile allocator which can be shared by several managers, it must be destroyed after all managers using it
+    SharedTileAllocator* CreateSharedTileAllocator(TilePlacementPolicy tilePlacementPolicy);
+
+    // Create a manager which allocates its tiles in the heaps of a shared tile allocator.
+    // Heaps added, reserved or removed through any of the attached managers are shared by all of them, tilePlacementPolicy of desc is ignored.
+    // Heap demand is the sum over all attached managers, which should use the same time base for timestamps.
+    // Tile moves returned by a manager only cover its own tiles, heaps holding tiles of other managers are not selected for defragmentation.
+    TiledTextureManager* CreateTiledTextureManager(const TiledTextureManagerDesc& desc, SharedTileAllocator* pSharedTileAllocator);
 } // rtxts
@@ -14,146 +14,635 @@
 
 namespace rtxts
 {
+    TiledHeap::TiledHeap()
+        : m_freeTilesNum(0)
+        , m_tilesNum(0)
+        , m_heapId(0)
+    {
+    }
+
     TiledHeap::TiledHeap(uint32_t tilesNum, uint32_t heapId)
-        : m_tilesNum(tilesNum)
-        , m_heapId(heapId)
     {
-        m_freeTileIndices.resize(m_tilesNum);
-        m_allocations.resize(m_tilesNum);
-        for (uint32_t i = 0; i < m_tilesNum; ++i)
-        {
-            m_freeTileIndices[i] = i;
-            m_allocations[i] = {};
-        }
+        Init(tilesNum, heapId);
     }
 
-    TileAllocation TiledHeap::AllocateTile(uint32_t textureId, uint32_t tileIndex)
+    void TiledHeap::Init(uint32_t tilesNum, uint32_t heapId)
     {
-        uint32_t heapTileIndex = m_freeTileIndices.back();
-        m_freeTileIndices.pop_back();
-        m_usedList.insert(heapTileIndex);
+        m_freeTilesNum = tilesNum;
+        m_tilesNum = tilesNum;
+        m_heapId = heapId;
+
+        m_usedTileBits.Init(m_tilesNum);
+        m_usedTileBits.Clear();
+        m_allocations.assign(m_tilesNum, TextureAndTile{});
+        m_ownerIds.assign(m_tilesNum, 0);
+    }
+
+    void TiledHeap::Reserve(uint32_t tilesNum)
+    {
+        m_usedTileBits.Reserve(tilesNum);
+        m_allocations.reserve(tilesNum);
+        m_ownerIds.reserve(tilesNum);
+    }
+
+    TileAllocation TiledHeap::AllocateTile(uint32_t ownerId, uint32_t textureId, uint32_t tileIndex, uint32_t firstHeapTileIndex)
+    {
+        uint32_t heapTileIndex = m_usedTileBits.FindNextClearBit(firstHeapTileIndex);
+        if (heapTileIndex >= m_tilesNum)
+            heapTileIndex = m_usedTileBits.FindNextClearBit(0);
+        m_usedTileBits.SetBit(heapTileIndex);
+        m_freeTilesNum--;
 
         auto& textureAllocation = m_allocations[heapTileIndex];
         textureAllocation.textureId = textureId;
         textureAllocation.tileIndex = tileIndex;
+        m_ownerIds[heapTileIndex] = ownerId;
 
         TileAllocation heapAllocation;
         heapAllocation.heapId = m_heapId;
         heapAllocation.heapTileIndex = heapTileIndex;
-        heapAllocation.pHeap = this;
 
         return heapAllocation;
     }
 
     void TiledHeap::FreeTile(uint32_t heapTileIndex)
     {
-        m_usedList.erase(heapTileIndex);
-        m_freeTileIndices.push_back(heapTileIndex);
+        m_usedTileBits.ClearBit(heapTileIndex);
+        m_freeTilesNum++;
         m_allocations[heapTileIndex] = {};
     }
 
-    TileAllocator::TileAllocator(uint32_t heapSizeInTiles, uint32_t tileSizeInBytes)
-        : m_heapSizeInTiles(heapSizeInTiles)
+    void TiledHeap::SetTileOwner(uint32_t heapTileIndex, uint32_t textureId, uint32_t tileIndex)
+    {
+        m_allocations[heapTileIndex].textureId = textureId;
+        m_allocations[heapTileIndex].tileIndex = tileIndex;
+    }
+
+    TileAllocator::TileAllocator(uint32_t tileSizeInBytes, TilePlacementPolicy tilePlacementPolicy)
+        : m_tilePlacementPolicy(tilePlacementPolicy)
         , m_tileSizeInBytes(tileSizeInBytes)
+        , m_totalTilesNum(0)
         , m_allocatedTilesNum(0)
     {
     }
 
-    void TileAllocator::AddHeap(uint32_t heapId)
+    void TileAllocator::Reserve(uint32_t heapsNum, uint32_t heapTilesNum)
     {
-        m_heaps.push_back(std::make_shared<TiledHeap>(m_heapSizeInTiles, heapId));
+        m_heapIdToSlot.Reserve(heapsNum);
+        m_reservedHeapSlots.reserve(heapsNum);
+        m_candidateSlots.reserve(heapsNum);
+        m_heapsNumByCapacity[heapTilesNum];
+
+        // Slots with heap storage are handed out by AddHeap() before new slots are created
+        uint32_t firstSlot = (uint32_t)m_heapSlots.size();
+        if (heapsNum > firstSlot)
+        {
+            m_heapSlots.resize(heapsNum);
+            m_heapSlotFreelist.reserve(heapsNum);
+            for (uint32_t slot = heapsNum; slot-- > firstSlot;)
+            {
+                m_heapSlots[slot].heap.Reserve(heapTilesNum);
+                m_heapSlotFreelist.push_back(slot);
+            }
+        }
+
+        for (auto& heapGroup : m_heapGroups)
+        {
+            if (heapGroup.heapsWithFreeTiles.GetBitsNum() < m_heapSlots.size())
+                heapGroup.heapsWithFreeTiles.Init((uint32_t)m_heapSlots.size());
+
+            if (heapGroup.bucketHeads.size() < heapTilesNum + 1)
+            {
+                heapGroup.bucketHeads.resize(heapTilesNum + 1, UINT32_MAX);
+                heapGroup.nonEmptyBuckets.Init(heapTilesNum + 1);
+            }
+        }
     }
 
-    void TileAllocator::RemoveHeap(uint32_t heapId)
+    uint32_t TileAllocator::AttachOwner(TiledTextureManager* pOwner)
+    {
+        auto it = std::find(m_owners.begin(), m_owners.end(), nullptr);
+        if (it != m_owners.end())
+        {
+            *it = pOwner;
+            return uint32_t(it - m_owners.begin());
+        }
+
+        m_owners.push_back(pOwner);
+        m_ownerAllocatedTilesNums.push_back(0);
+        return uint32_t(m_owners.size() - 1);
+    }
+
+    void TileAllocator::DetachOwner(uint32_t ownerId)
+    {
+        m_owners[ownerId] = nullptr;
+    }
+
+    void TileAllocator::AddHeap(uint32_t heapId, uint32_t heapTilesNum, bool isReserved)
     {
-        for (auto it = m_heaps.begin(); it != m_heaps.end(); ++it)
+        uint32_t slot;
+        if (!m_heapSlotFreelist.empty())
+        {
+            slot = m_heapSlotFreelist.back();
+            m_heapSlotFreelist.pop_back();
+        }
+        else
+        {
+            slot = (uint32_t)m_heapSlots.size();
+            m_heapSlots.push_back(HeapSlot());
+        }
+
+        HeapSlot& heapSlot = m_heapSlots[slot];
+        heapSlot.heap.Init(heapTilesNum, heapId);
+        heapSlot.isActive = true;
+        heapSlot.isReserved = isReserved;
+        m_heapIdToSlot.insert(heapId, slot);
+        if (isReserved)
+            m_reservedHeapSlots.push_back(slot);
+        m_totalTilesNum += heapTilesNum;
+        m_heapsNumByCapacity[heapTilesNum]++;
+
+        uint32_t bucketsNum = heapSlot.heap.FreeTilesNum() + 1;
+        for (auto& heapGroup : m_heapGroups)
         {
-            if ((*it)->GetHeapId() == heapId)
+            if (heapGroup.heapsWithFreeTiles.GetBitsNum() < m_heapSlots.size())
+                heapGroup.heapsWithFreeTiles.Init((uint32_t)m_heapSlots.size());
+
+            if (heapGroup.bucketHeads.size() < bucketsNum)
             {
-                m_heaps.erase(it);
-                return;
+                heapGroup.bucketHeads.resize(bucketsNum, UINT32_MAX);
+                heapGroup.nonEmptyBuckets.Init(bucketsNum);
             }
         }
+
+        LinkHeap(slot);
+    }
+
+    void TileAllocator::RemoveHeap(uint32_t heapId)
+    {
+        const uint32_t* pSlot = m_heapIdToSlot.find(heapId);
+        if (!pSlot)
+            return;
+
+        uint32_t slot = *pSlot;
+        m_heapIdToSlot.erase(heapId);
+
+        HeapSlot& heapSlot = m_heapSlots[slot];
+        UnlinkHeap(slot);
+        SetHeapExcluded(slot, false);
+        TrackHeapOccupancy(slot, false);
+        m_totalTilesNum -= (uint32_t)heapSlot.heap.TotalTilesNum();
+        m_allocatedTilesNum -= heapSlot.heap.AllocatedTilesNum();
+        for (uint32_t heapTileIndex : heapSlot.heap.GetUsedTileBits())
+            m_ownerAllocatedTilesNums[heapSlot.heap.GetOwnerIds()[heapTileIndex]]--;
+
+        // Entries stay at zero so adding a heap of the same capacity again doesn't allocate
+        m_heapsNumByCapacity[(uint32_t)heapSlot.heap.TotalTilesNum()]--;
+
+        if (heapSlot.isReserved)
+            m_reservedHeapSlots.erase(std::find(m_reservedHeapSlots.begin(), m_reservedHeapSlots.end(), slot));
+
+        // Bump the generation so outstanding handles to this slot become invalid
+        heapSlot.heap.Init(0, 0);
+        heapSlot.isActive = false;
+        heapSlot.isReserved = false;
+        heapSlot.generation = (heapSlot.generation + 1) & (UINT32_MAX >> HeapSlotBits);
+        m_heapSlotFreelist.push_back(slot);
+    }
+
+    void TileAllocator::CommitHeap(uint32_t heapId)
+    {
+        const uint32_t* pSlot = m_heapIdToSlot.find(heapId);
+        if (!pSlot || !m_heapSlots[*pSlot].isReserved)
+            return;
+
+        uint32_t slot = *pSlot;
+        m_heapSlots[slot].isReserved = false;
+        m_reservedHeapSlots.erase(std::find(m_reservedHeapSlots.begin(), m_reservedHeapSlots.end(), slot));
+        LinkHeap(slot);
+    }
+
+    void TileAllocator::ExcludeHeap(uint32_t heapId)
+    {
+        const uint32_t* pSlot = m_heapIdToSlot.find(heapId);
+        if (!pSlot)
+            return;
+
+        UnlinkHeap(*pSlot);
+        SetHeapExcluded(*pSlot, true);
+    }
+
+    void TileAllocator::IncludeHeap(uint32_t heapId)
+    {
+        const uint32_t* pSlot = m_heapIdToSlot.find(heapId);
+        if (!pSlot || !m_heapSlots[*pSlot].isExcluded)
+            return;
+
+        SetHeapExcluded(*pSlot, false);
+        LinkHeap(*pSlot);
+    }
+
+    // Excluded heaps don't count towards the capacity and the free tiles available for new allocations
+    void TileAllocator::SetHeapExcluded(uint32_t slot, bool isExcluded)
+    {
+        HeapSlot& heapSlot = m_heapSlots[slot];
+        if (heapSlot.isExcluded == isExcluded)
+            return;
+
+        heapSlot.isExcluded = isExcluded;
+        if (isExcluded)
+        {
+            m_excludedTilesNum += (uint32_t)heapSlot.heap.TotalTilesNum();
+            m_excludedAllocatedTilesNum += heapSlot.heap.AllocatedTilesNum();
+        }
+        else
+        {
+            m_excludedTilesNum -= (uint32_t)heapSlot.heap.TotalTilesNum();
+            m_excludedAllocatedTilesNum -= heapSlot.heap.AllocatedTilesNum();
+        }
+    }
+
+    HeapHandle TileAllocator::GetHeapHandle(uint32_t heapId) const
+    {
+        const uint32_t* pSlot = m_heapIdToSlot.find(heapId);
+        if (!pSlot)
+            return InvalidHeapHandle;
+
+        return (m_heapSlots[*pSlot].generation << HeapSlotBits) | *pSlot;
+    }
+
+    TiledHeap* TileAllocator::GetHeap(HeapHandle heapHandle)
+    {
+        uint32_t slot = heapHandle & HeapSlotMask;
+        if (heapHandle == InvalidHeapHandle || slot >= m_heapSlots.size())
+            return nullptr;
+
+        HeapSlot& heapSlot = m_heapSlots[slot];
+        if (!heapSlot.isActive || heapSlot.generation != (heapHandle >> HeapSlotBits))
+            return nullptr;
+
+        return &heapSlot.heap;
+    }
+
+    bool TileAllocator::IsReservedHeap(uint32_t heapId) const
+    {
+        const uint32_t* pSlot = m_heapIdToSlot.find(heapId);
+        return pSlot && m_heapSlots[*pSlot].isReserved;
+    }
+
+    uint32_t TileAllocator::FindFreeHeapSlot(const HeapGroup& heapGroup) const
+    {
+        switch (m_tilePlacementPolicy)
+        {
+        case TilePlacementPolicy_BestFit:
+        {
+            // The lowest non-empty bucket holds the heaps with the fewest free tiles
+            uint32_t bucket = heapGroup.nonEmptyBuckets.FindNextSetBit(1);
+            return bucket < heapGroup.nonEmptyBuckets.GetBitsNum() ? heapGroup.bucketHeads[bucket] : UINT32_MAX;
+        }
+        case TilePlacementPolicy_FirstFit:
+        {
+            uint32_t slot = heapGroup.heapsWithFreeTiles.FindNextSetBit(0);
+            return slot < heapGroup.heapsWithFreeTiles.GetBitsNum() ? slot : UINT32_MAX;
+        }
+        }
+
+        return UINT32_MAX;
     }
 
-    std::shared_ptr<TiledHeap> TileAllocator::FindFreeHeap()
+    uint32_t TileAllocator::FindFreeHeapSlot(TileLifetimeClass lifetimeClass) const
     {
-        for (auto heap : m_heaps)
-            if (heap->FreeTilesNum())
-                return heap;
+        uint32_t slot = FindFreeHeapSlot(m_heapGroups[lifetimeClass]);
+        if (slot == UINT32_MAX && m_useEmptyHeaps)
+            slot = FindFreeHeapSlot(m_heapGroups[EmptyHeapGroup]);
+
+        // Mix lifetime classes rather than failing the allocation
+        for (uint32_t group = 0; slot == UINT32_MAX && group < TileLifetimeClass_Count; ++group)
+            slot = FindFreeHeapSlot(m_heapGroups[group]);
 
-        return nullptr;
+        return slot;
     }
 
-    TileAllocation TileAllocator::AllocateTile(uint32_t textureId, uint32_t tileIndex)
+    uint32_t TileAllocator::FindFreeReservedHeapSlot(TileLifetimeClass lifetimeClass) const
+    {
+        // Reserved heaps are never linked into groups, there are only a few of them while heaps are being created
+        uint32_t fallbackSlot = UINT32_MAX;
+        for (uint32_t slot : m_reservedHeapSlots)
+        {
+            const HeapSlot& heapSlot = m_heapSlots[slot];
+            if (!heapSlot.heap.FreeTilesNum())
+                continue;
+
+            if (heapSlot.heap.IsEmpty() || heapSlot.lifetimeClass == lifetimeClass)
+                return slot;
+
+            if (fallbackSlot == UINT32_MAX)
+                fallbackSlot = slot;
+        }
+
+        return fallbackSlot;
+    }
+
+    TileAllocation TileAllocator::AllocateTile(uint32_t ownerId, uint32_t textureId, uint32_t tileIndex, TileLifetimeClass lifetimeClass, HeapHandle preferredHeap, uint32_t preferredHeapTileIndex, bool allowReservedHeaps)
     {
         TileAllocation tileAllocation = {};
 
-        auto pHeap = FindFreeHeap();
-        if (!pHeap)
+        // Only heaps linked into a group have free tiles and accept new allocations.
+        // The preferred heap wins over the placement policy, unless it is empty: the policy decides which heap is started next
+        uint32_t slot = UINT32_MAX;
+        TiledHeap* pPreferredHeap = GetHeap(preferredHeap);
+        if (pPreferredHeap && m_heapSlots[preferredHeap & HeapSlotMask].bucket && !pPreferredHeap->IsEmpty() && m_heapSlots[preferredHeap & HeapSlotMask].lifetimeClass == lifetimeClass)
+        {
+            slot = preferredHeap & HeapSlotMask;
+        }
+        else
+        {
+            slot = FindFreeHeapSlot(lifetimeClass);
+            if (slot == UINT32_MAX && allowReservedHeaps)
+                slot = FindFreeReservedHeapSlot(lifetimeClass);
+            preferredHeapTileIndex = 0;
+        }
+
+        if (slot == UINT32_MAX)
             return tileAllocation;
 
+        HeapSlot& heapSlot = m_heapSlots[slot];
+        TiledHeap& heap = heapSlot.heap;
+
         m_allocatedTilesNum++;
+        m_ownerAllocatedTilesNums[ownerId]++;
+
+        UnlinkHeap(slot);
+        TrackHeapOccupancy(slot, false);
+        if (heap.IsEmpty())
+            heapSlot.lifetimeClass = lifetimeClass;
+        tileAllocation = heap.AllocateTile(ownerId, textureId, tileIndex, preferredHeapTileIndex);
+        TrackHeapOccupancy(slot, true);
+        LinkHeap(slot);
 
-        return pHeap->AllocateTile(textureId, tileIndex);
+        return tileAllocation;
     }
 
     void TileAllocator::FreeTile(TileAllocation& tileAllocation)
     {
-        if (!tileAllocation.pHeap)
+        if (!tileAllocation.IsValid())
+            return;
+
+        // The heap may already have been removed
+        const uint32_t* pSlot = m_heapIdToSlot.find(tileAllocation.heapId);
+        if (!pSlot)
             return;
 
-        TiledHeap* pTiledHeap = reinterpret_cast<TiledHeap*>(tileAllocation.pHeap);
-        pTiledHeap->FreeTile(tileAllocation.heapTileIndex);
+        uint32_t slot = *pSlot;
+        TiledHeap& heap = m_heapSlots[slot].heap;
+        if (!heap.GetUsedTileBits().GetBit(tileAllocation.heapTileIndex))
+            return;
+
+        m_ownerAllocatedTilesNums[heap.GetOwnerIds()[tileAllocation.heapTileIndex]]--;
+
+        UnlinkHeap(slot);
+        TrackHeapOccupancy(slot, false);
+        heap.FreeTile(tileAllocation.heapTileIndex);
+        TrackHeapOccupancy(slot, true);
+        LinkHeap(slot);
+
         m_allocatedTilesNum--;
+        if (m_heapSlots[slot].isExcluded)
+            m_excludedAllocatedTilesNum--;
     }
 
-    TextureAndTile TileAllocator::GetFragmentedTextureTile(TiledTextureManager* tiledTextureManager) const
+    void TileAllocator::SetTileOwner(const TileAllocation& tileAllocation, uint32_t textureId, uint32_t tileIndex)
     {
-        TextureAndTile tileAllocation = {};
+        const uint32_t* pSlot = m_heapIdToSlot.find(tileAllocation.heapId);
+        if (!pSlot)
+            return;
 
-        // We need at least 2 heaps
-        if (m_heaps.size() < 2)
-            return tileAllocation;
+        m_heapSlots[*pSlot].heap.SetTileOwner(tileAllocation.heapTileIndex, textureId, tileIndex);
+    }
+
+    // Links a heap into the group of its lifetime class and the bucket matching its number of free tiles
+    void TileAllocator::LinkHeap(uint32_t slot)
+    {
+        HeapSlot& heapSlot = m_heapSlots[slot];
+        uint32_t bucket = heapSlot.heap.FreeTilesNum();
+        if (!bucket || heapSlot.isExcluded || heapSlot.isReserved)
+            return;
+
+        HeapGroup& heapGroup = m_heapGroups[heapSlot.heap.IsEmpty() ? EmptyHeapGroup : static_cast<uint32_t>(heapSlot.lifetimeClass)];
+
+        heapSlot.group = uint32_t(&heapGroup - m_heapGroups);
+        heapSlot.bucket = bucket;
+        heapSlot.prevSlot = UINT32_MAX;
+        heapSlot.nextSlot = heapGroup.bucketHeads[bucket];
+        if (heapSlot.nextSlot != UINT32_MAX)
+            m_heapSlots[heapSlot.nextSlot].prevSlot = slot;
+        heapGroup.bucketHeads[bucket] = slot;
+
+        heapGroup.nonEmptyBuckets.SetBit(bucket);
+        heapGroup.heapsWithFreeTiles.SetBit(slot);
+    }
+
+    void TileAllocator::UnlinkHeap(uint32_t slot)
+    {
+        HeapSlot& heapSlot = m_heapSlots[slot];
+        uint32_t bucket = heapSlot.bucket;
+        if (!bucket)
+            return;
+
+        HeapGroup& heapGroup = m_heapGroups[heapSlot.group];
+
+        if (heapSlot.prevSlot != UINT32_MAX)
+            m_heapSlots[heapSlot.prevSlot].nextSlot = heapSlot.nextSlot;
+        else
+            heapGroup.bucketHeads[bucket] = heapSlot.nextSlot;
+
+        if (heapSlot.nextSlot != UINT32_MAX)
+            m_heapSlots[heapSlot.nextSlot].prevSlot = heapSlot.prevSlot;
+
+        if (heapGroup.bucketHeads[bucket] == UINT32_MAX)
+            heapGroup.nonEmptyBuckets.ClearBit(bucket);
+        heapGroup.heapsWithFreeTiles.ClearBit(slot);
 
-        // Discover if we are at all fragmented by looking at all heaps except the last
-        bool isFragmented = false;
-        for (uint32_t iHeap = 0; iHeap < m_heaps.size() - 1; iHeap++)
+        heapSlot.prevSlot = UINT32_MAX;
+        heapSlot.nextSlot = UINT32_MAX;
+        heapSlot.group = 0;
+        heapSlot.bucket = 0;
+    }
+
+    void TileAllocator::TrackHeapOccupancy(uint32_t slot, bool add)
+    {
+        // Empty heaps don't belong to any lifetime class
+        const HeapSlot& heapSlot = m_heapSlots[slot];
+        if (heapSlot.heap.IsEmpty())
+            return;
+
+        uint32_t sign = add ? 1 : UINT32_MAX;
+        LifetimeClassStatistics& classStatistics = m_lifetimeClassStatistics[heapSlot.lifetimeClass];
+        classStatistics.heapsNum += sign;
+        classStatistics.allocatedTilesNum += sign * heapSlot.heap.AllocatedTilesNum();
+        classStatistics.totalTilesNum += sign * (uint32_t)heapSlot.heap.TotalTilesNum();
+        m_usedHeapsNum += sign;
+    }
+
+    void TileAllocator::SelectHeapsToRelease(uint32_t ownerId, uint32_t maxHeapsNum, uint32_t maxTilesNum, std::vector<uint32_t>& heapIds, std::vector<TextureAndTile>& tiles)
+    {
+        // Candidates are non-empty heaps which accept allocations, the free tiles of the others are the destination of moves
+        auto& candidateSlots = m_candidateSlots;
+        candidateSlots.clear();
+        uint32_t dstFreeTilesNum = 0;
+        for (uint32_t slot = 0; slot < (uint32_t)m_heapSlots.size(); ++slot)
         {
-            if (m_heaps[iHeap]->FreeTilesNum() > 0)
-            {
-                isFragmented = true;
-                break;
-            }
+            const HeapSlot& heapSlot = m_heapSlots[slot];
+            if (!heapSlot.isActive || heapSlot.isExcluded || heapSlot.isReserved || heapSlot.heap.IsEmpty())
+                continue;
+
+            candidateSlots.push_back(slot);
+            dstFreeTilesNum += heapSlot.heap.FreeTilesNum();
         }
 
-        if (!isFragmented)
-            return tileAllocation;
+        std::sort(candidateSlots.begin(), candidateSlots.end(), [this](uint32_t slotA, uint32_t slotB)
+            {
+                return m_heapSlots[slotA].heap.AllocatedTilesNum() < m_heapSlots[slotB].heap.AllocatedTilesNum();
+            });
 
-        // Iterate from the back to find a tile to defragment
-        for (uint32_t iHeap = uint32_t(m_heaps.size()) - 1; iHeap > 0; iHeap--)
+        // Greedily take the least occupied heaps while the moves fit in the budget and the remaining heaps
+        for (uint32_t slot : candidateSlots)
         {
-            auto& heap = m_heaps[iHeap];
-            if (!heap->IsEmpty())
+            const TiledHeap& heap = m_heapSlots[slot].heap;
+            if (heapIds.size() >= maxHeapsNum || tiles.size() + heap.AllocatedTilesNum() > maxTilesNum)
+                break;
+
+            if (dstFreeTilesNum - heap.FreeTilesNum() < tiles.size() + heap.AllocatedTilesNum())
+                break;
+
+            // A heap can only be released if all of its tiles belong to the owner and can be moved
+            size_t firstTile = tiles.size();
+            bool isMovable = true;
+            for (uint32_t heapTileIndex : heap.GetUsedTileBits())
             {
-                for (auto& heapAllocationIndex : heap->GetUsedTileSet())
+                const TextureAndTile& textureAndTile = heap.GetAllocations()[heapTileIndex];
+                if (heap.GetOwnerIds()[heapTileIndex] != ownerId || !m_owners[ownerId]->IsMovableTile(textureAndTile.textureId, textureAndTile.tileIndex))
                 {
-                    auto tileAllocation = heap->GetAllocations()[heapAllocationIndex];
-                    if (tiledTextureManager->IsMovableTile(tileAllocation.textureId, tileAllocation.tileIndex))
-                    {
-                        return tileAllocation;
-                    }
+                    isMovable = false;
+                    break;
                 }
+                tiles.push_back(textureAndTile);
             }
+
+            if (!isMovable)
+            {
+                tiles.resize(firstTile);
+                continue;
+            }
+
+            dstFreeTilesNum -= heap.FreeTilesNum();
+            heapIds.push_back(heap.GetHeapId());
         }
+    }
 
-        return tileAllocation;
+    void TileAllocator::AllocateMoveDestinations(uint32_t ownerId, const std::vector<uint32_t>& srcHeapIds, const std::vector<TextureAndTile>& tiles, const std::vector<TileLifetimeClass>& lifetimeClasses, std::vector<TileAllocation>& dstAllocations)
+    {
+        // Hide the source heaps and empty heaps from the placement policy while allocating
+        for (uint32_t heapId : srcHeapIds)
+            UnlinkHeap(m_heapIdToSlot.at(heapId));
+        m_useEmptyHeaps = false;
+
+        dstAllocations.resize(tiles.size());
+        for (size_t i = 0; i < tiles.size(); ++i)
+            dstAllocations[i] = AllocateTile(ownerId, tiles[i].textureId, tiles[i].tileIndex, lifetimeClasses[i]);
+
+        m_useEmptyHeaps = true;
+        for (uint32_t heapId : srcHeapIds)
+            LinkHeap(m_heapIdToSlot.at(heapId));
+    }
+
+    uint32_t TileAllocator::ExcludeHeapsToTrim(uint32_t tilesNum, std::vector<uint32_t>& heapIds)
+    {
+        auto& candidateSlots = m_candidateSlots;
+        candidateSlots.clear();
+        for (uint32_t slot = 0; slot < (uint32_t)m_heapSlots.size(); ++slot)
+        {
+            if (m_heapSlots[slot].isActive && !m_heapSlots[slot].isReserved && !m_heapSlots[slot].isExcluded)
+                candidateSlots.push_back(slot);
+        }
+
+        // Fewest tiles to release first, larger heaps first among equally occupied ones
+        std::sort(candidateSlots.begin(), candidateSlots.end(), [this](uint32_t slotA, uint32_t slotB)
+            {
+                const TiledHeap& heapA = m_heapSlots[slotA].heap;
+                const TiledHeap& heapB = m_heapSlots[slotB].heap;
+                if (heapA.AllocatedTilesNum() != heapB.AllocatedTilesNum())
+                    return heapA.AllocatedTilesNum() < heapB.AllocatedTilesNum();
+                return heapA.TotalTilesNum() > heapB.TotalTilesNum();
+            });
+
+        uint32_t excludedTilesNum = 0;
+        for (uint32_t slot : candidateSlots)
+        {
+            if (excludedTilesNum >= tilesNum)
+                break;
+
+            UnlinkHeap(slot);
+            SetHeapExcluded(slot, true);
+            excludedTilesNum += (uint32_t)m_heapSlots[slot].heap.TotalTilesNum();
+            heapIds.push_back(m_heapSlots[slot].heap.GetHeapId());
+        }
+
+        return excludedTilesNum;
     }
 
     void TileAllocator::GetEmptyHeaps(std::vector<uint32_t>& emptyHeaps) const
     {
-        for (auto& heap : m_heaps)
-            if (heap->IsEmpty())
-                emptyHeaps.push_back(heap->GetHeapId());
+        size_t firstEmptyHeap = emptyHeaps.size();
+        for (auto& heapSlot : m_heapSlots)
+            if (heapSlot.isActive && !heapSlot.isReserved && heapSlot.heap.IsEmpty())
+                emptyHeaps.push_back(heapSlot.heap.GetHeapId());
+
+        // Smallest heaps first so capacity shrinks in fine steps
+        std::stable_sort(emptyHeaps.begin() + firstEmptyHeap, emptyHeaps.end(), [this](uint32_t heapIdA, uint32_t heapIdB)
+            {
+                return m_heapSlots[m_heapIdToSlot.at(heapIdA)].heap.TotalTilesNum() < m_heapSlots[m_heapIdToSlot.at(heapIdB)].heap.TotalTilesNum();
+            });
+    }
+
+    void TileAllocator::GetExtendedStatistics(ExtendedStatistics& statistics) const
+    {
+        statistics.heapsNum = (uint32_t)m_heapIdToSlot.size();
+        statistics.usedHeapsNum = m_usedHeapsNum;
+        for (uint32_t lifetimeClass = 0; lifetimeClass < TileLifetimeClass_Count; ++lifetimeClass)
+            statistics.lifetimeClasses[lifetimeClass] = m_lifetimeClassStatistics[lifetimeClass];
+
+        // Fill the largest heaps first to find the fewest heaps which could hold all allocated tiles
+        statistics.minHeapsNum = 0;
+        uint32_t remainingTilesNum = m_allocatedTilesNum;
+        for (auto it = m_heapsNumByCapacity.rbegin(); it != m_heapsNumByCapacity.rend() && remainingTilesNum; ++it)
+        {
+            uint32_t heapsNum = std::min(it->second, (remainingTilesNum + it->first - 1) / it->first);
+            statistics.minHeapsNum += heapsNum;
+            remainingTilesNum -= std::min(remainingTilesNum, heapsNum * it->first);
+        }
+
+        // Entries are overwritten in place so a statistics object polled every frame keeps its storage
+        statistics.heaps.resize(statistics.heapsNum);
+        uint32_t heapIndex = 0;
+        uint32_t pinnedHeapsNum = 0;
+        for (auto& heapSlot : m_heapSlots)
+        {
+            if (!heapSlot.isActive)
+                continue;
+
+            // Reserved heaps and heaps being evacuated or trimmed are not released by a defragmentation
+            if (heapSlot.isReserved || heapSlot.isExcluded)
+                pinnedHeapsNum++;
+
+            HeapStatistics& heapStatistics = statistics.heaps[heapIndex++];
+            heapStatistics.heapId = heapSlot.heap.GetHeapId();
+            heapStatistics.allocatedTilesNum = heapSlot.heap.AllocatedTilesNum();
+            heapStatistics.freeTilesNum = heapSlot.heap.FreeTilesNum();
+            heapStatistics.lifetimeClass = heapSlot.lifetimeClass;
+        }
+
+        statistics.releasableHeapsNum = statistics.heapsNum - std::min(statistics.heapsNum, statistics.minHeapsNum + pinnedHeapsNum);
+        statistics.fragmentation = statistics.minHeapsNum ? float(m_usedHeapsNum) / float(statistics.minHeapsNum) : 1.0f;
     }
 } // rtxts
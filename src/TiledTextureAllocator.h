@@ -13,20 +13,35 @@
 #pragma once
 
 #include "../include/rtxts-ttm/TiledTextureManager.h"
+#include "TiledTextureManagerHelper.h"
 
 #include <vector>
-#include <set>
+#include <map>
 #include <memory>
+#include <unordered_map>
 
 namespace rtxts
 {
+    // Generation-checked reference to a slot in the heap table of a TileAllocator
+    typedef uint32_t HeapHandle;
+    static const HeapHandle InvalidHeapHandle = UINT32_MAX;
+
     class TiledHeap
     {
     public:
+        TiledHeap();
         TiledHeap(uint32_t tilesNum, uint32_t heapId);
 
-        TileAllocation AllocateTile(uint32_t textureId, uint32_t tileIndex);
+        // Resets the heap to the given number of free tiles, reusing its storage
+        void Init(uint32_t tilesNum, uint32_t heapId);
+
+        // Preallocate storage so Init() doesn't allocate up to the given number of tiles
+        void Reserve(uint32_t tilesNum);
+
+        // Allocates the first free heap tile at or after firstHeapTileIndex, wrapping around to the start of the heap
+        TileAllocation AllocateTile(uint32_t ownerId, uint32_t textureId, uint32_t tileIndex, uint32_t firstHeapTileIndex = 0);
         void FreeTile(uint32_t heapTileIndex);
+        void SetTileOwner(uint32_t heapTileIndex, uint32_t textureId, uint32_t tileIndex);
 
         uint32_t AllocatedTilesNum() const
         {
@@ -35,7 +50,7 @@ namespace rtxts
 
         uint32_t FreeTilesNum() const
         {
-            return (uint32_t)m_freeTileIndices.size();
+            return m_freeTilesNum;
         }
 
         uint64_t TotalTilesNum() const
@@ -45,12 +60,13 @@ namespace rtxts
 
         bool IsEmpty() const
         {
-            return m_freeTileIndices.size() == m_tilesNum;
+            return m_freeTilesNum == m_tilesNum;
         }
 
-        const std::set<uint32_t>& GetUsedTileSet() const
+        // One bit per heap tile, set for tiles which are in use
+        const BitArray& GetUsedTileBits() const
         {
-            return m_usedList;
+            return m_usedTileBits;
         }
 
         const std::vector<TextureAndTile>& GetAllocations() const
@@ -58,33 +74,65 @@ namespace rtxts
             return m_allocations;
         }
 
+        // Manager which owns the tile in each heap tile
+        const std::vector<uint32_t>& GetOwnerIds() const
+        {
+            return m_ownerIds;
+        }
+
         uint32_t GetHeapId() const { return m_heapId; }
 
     private:
-        std::vector<uint32_t> m_freeTileIndices;
-        std::set<uint32_t> m_usedList;
+        BitArray m_usedTileBits;
         std::vector<TextureAndTile> m_allocations;
+        std::vector<uint32_t> m_ownerIds;
+        uint32_t m_freeTilesNum;
 
-        const uint32_t m_tilesNum;
-        const uint32_t m_heapId;
+        uint32_t m_tilesNum;
+        uint32_t m_heapId;
     };
 
-    class TileAllocator
+    class TileAllocator : public SharedTileAllocator
     {
     public:
-        TileAllocator(uint32_t heapSizeInTiles, uint32_t tileSizeInBytes);
+        TileAllocator(uint32_t tileSizeInBytes, TilePlacementPolicy tilePlacementPolicy);
+
+        // Preallocate storage for the given number of heaps of up to heapTilesNum tiles, adding and removing such heaps then doesn't allocate
+        void Reserve(uint32_t heapsNum, uint32_t heapTilesNum);
+
+        // Managers allocating tiles in the heaps, owner ids of detached managers are reused
+        uint32_t AttachOwner(TiledTextureManager* pOwner);
+        void DetachOwner(uint32_t ownerId);
+
+        const std::vector<TiledTextureManager*>& GetOwners() const
+        {
+            return m_owners;
+        }
 
-        void AddHeap(uint32_t heapId);
+        // Reserved heaps are still being created, they only receive tiles when allowed explicitly and no other heap has space
+        void AddHeap(uint32_t heapId, uint32_t heapTilesNum, bool isReserved = false);
         void RemoveHeap(uint32_t heapId);
+        void CommitHeap(uint32_t heapId);
 
-        std::shared_ptr<TiledHeap> FindFreeHeap();
+        // Exclude a heap from new allocations, e.g. while it is being evacuated
+        void ExcludeHeap(uint32_t heapId);
+        void IncludeHeap(uint32_t heapId);
 
-        TileAllocation AllocateTile(uint32_t textureId, uint32_t tileIndex);
+        HeapHandle GetHeapHandle(uint32_t heapId) const;
+        TiledHeap* GetHeap(HeapHandle heapHandle);
+        bool IsReservedHeap(uint32_t heapId) const;
+
+        // Allocates a tile in the preferred heap near the preferred heap tile if it has space and is not empty, otherwise in the heap chosen by the placement policy.
+        // Heaps are assigned to a lifetime class by their first tile and return to a shared pool once they are empty.
+        TileAllocation AllocateTile(uint32_t ownerId, uint32_t textureId, uint32_t tileIndex, TileLifetimeClass lifetimeClass, HeapHandle preferredHeap = InvalidHeapHandle, uint32_t preferredHeapTileIndex = 0, bool allowReservedHeaps = false);
         void FreeTile(TileAllocation& tileAllocation);
 
+        // Hands an allocated heap tile over to another tile of the same owner
+        void SetTileOwner(const TileAllocation& tileAllocation, uint32_t textureId, uint32_t tileIndex);
+
         uint32_t GetHeapsNum()
         {
-            return (uint32_t)m_heaps.size();
+            return (uint32_t)m_heapIdToSlot.size();
         }
 
         uint32_t GetAllocatedTilesNum()
@@ -92,24 +140,119 @@ namespace rtxts
             return m_allocatedTilesNum;
         }
 
+        uint32_t GetAllocatedTilesNum(uint32_t ownerId)
+        {
+            return m_ownerAllocatedTilesNums[ownerId];
+        }
+
+        // Capacity of the heaps which are not excluded from new allocations
         uint32_t GetTotalTilesNum()
         {
-            return GetHeapsNum() * m_heapSizeInTiles;
+            return m_totalTilesNum - m_excludedTilesNum;
         }
 
         uint32_t GetFreeTilesNum()
         {
-            return GetTotalTilesNum() - m_allocatedTilesNum;
+            return GetTotalTilesNum() - (m_allocatedTilesNum - m_excludedAllocatedTilesNum);
         }
 
-        TextureAndTile GetFragmentedTextureTile(TiledTextureManager* tiledTextureManager) const;
+        uint32_t GetTileSizeInBytes() const
+        {
+            return m_tileSizeInBytes;
+        }
+
+        // Maximum number of tiles which can be allocated in all heaps
+        void SetBudgetTilesNum(uint32_t budgetTilesNum)
+        {
+            m_budgetTilesNum = budgetTilesNum;
+        }
+
+        uint32_t GetBudgetTilesNum() const
+        {
+            return m_budgetTilesNum;
+        }
+
+        // Selects heaps with the fewest allocated tiles until their capacity reaches the given number of tiles and excludes them from new allocations
+        uint32_t ExcludeHeapsToTrim(uint32_t tilesNum, std::vector<uint32_t>& heapIds);
+
+        // Selects up to maxHeapsNum of the least occupied heaps which can be emptied by moving at most maxTilesNum tiles into the free tiles of the other non-empty heaps.
+        // Only heaps whose tiles all belong to the owner are selected.
+        void SelectHeapsToRelease(uint32_t ownerId, uint32_t maxHeapsNum, uint32_t maxTilesNum, std::vector<uint32_t>& heapIds, std::vector<TextureAndTile>& tiles);
+
+        // Allocates destinations for tiles moved out of the source heaps, only in other heaps which are not empty
+        void AllocateMoveDestinations(uint32_t ownerId, const std::vector<uint32_t>& srcHeapIds, const std::vector<TextureAndTile>& tiles, const std::vector<TileLifetimeClass>& lifetimeClasses, std::vector<TileAllocation>& dstAllocations);
 
         void GetEmptyHeaps(std::vector<uint32_t>& emptyHeaps) const;
 
+        void GetExtendedStatistics(ExtendedStatistics& statistics) const;
+
     private:
-        std::vector<std::shared_ptr<TiledHeap>> m_heaps;
-        const uint32_t m_heapSizeInTiles;
+        static const uint32_t HeapSlotBits = 24;
+        static const uint32_t HeapSlotMask = (1u << HeapSlotBits) - 1;
+
+        struct HeapSlot
+        {
+            TiledHeap heap;
+            uint32_t generation = 0;
+            bool isActive = false;
+            bool isExcluded = false;
+            bool isReserved = false;
+
+            TileLifetimeClass lifetimeClass = TileLifetimeClass_Short;
+
+            // Links of the intrusive list of heaps in the same group with the same number of free tiles
+            uint32_t prevSlot = UINT32_MAX;
+            uint32_t nextSlot = UINT32_MAX;
+            uint32_t group = 0;
+            uint32_t bucket = 0; // number of free tiles when linked, 0 for full heaps which are not in any list
+        };
+
+        // Heaps with free tiles, bucketed by their number of free tiles
+        struct HeapGroup
+        {
+            std::vector<uint32_t> bucketHeads;
+            BitArray nonEmptyBuckets;
+            BitArray heapsWithFreeTiles; // One bit per heap slot
+        };
+
+        // One group of heaps per lifetime class and one for empty heaps, which don't belong to any class
+        static const uint32_t EmptyHeapGroup = TileLifetimeClass_Count;
+        static const uint32_t HeapGroupsNum = TileLifetimeClass_Count + 1;
+
+        void LinkHeap(uint32_t slot);
+        void UnlinkHeap(uint32_t slot);
+        void SetHeapExcluded(uint32_t slot, bool isExcluded);
+        uint32_t FindFreeHeapSlot(const HeapGroup& heapGroup) const;
+        uint32_t FindFreeHeapSlot(TileLifetimeClass lifetimeClass) const;
+        uint32_t FindFreeReservedHeapSlot(TileLifetimeClass lifetimeClass) const;
+
+        // Adds or subtracts the contribution of a heap to the occupancy statistics, around every change of its allocated tiles
+        void TrackHeapOccupancy(uint32_t slot, bool add);
+
+        std::vector<HeapSlot> m_heapSlots;
+        std::vector<uint32_t> m_heapSlotFreelist;
+        FlatHashMap<uint32_t, uint32_t> m_heapIdToSlot;
+        std::vector<uint32_t> m_reservedHeapSlots;
+
+        std::vector<TiledTextureManager*> m_owners;
+        std::vector<uint32_t> m_ownerAllocatedTilesNums;
+
+        HeapGroup m_heapGroups[HeapGroupsNum];
+        bool m_useEmptyHeaps = true;
+
+        const TilePlacementPolicy m_tilePlacementPolicy;
         const uint32_t m_tileSizeInBytes;
+        uint32_t m_totalTilesNum = 0;
         uint32_t m_allocatedTilesNum = 0;
+        uint32_t m_excludedTilesNum = 0; // Capacity of excluded heaps
+        uint32_t m_excludedAllocatedTilesNum = 0; // Tiles still allocated in excluded heaps
+        uint32_t m_budgetTilesNum = UINT32_MAX;
+
+        // Occupancy statistics
+        uint32_t m_usedHeapsNum = 0;
+        LifetimeClassStatistics m_lifetimeClassStatistics[TileLifetimeClass_Count] = {};
+        std::map<uint32_t, uint32_t> m_heapsNumByCapacity;
+
+        std::vector<uint32_t> m_candidateSlots; // Scratch storage for heap selection
     };
 } // rtxts
@@ -12,24 +12,85 @@
 
 #include "TiledTextureManagerImpl.h"
 
+#include <cmath>
+
 #if _DEBUG
 #include <assert.h>
 #endif
 
 namespace rtxts
 {
-    TiledTextureManagerImpl::TiledTextureManagerImpl(const TiledTextureManagerDesc& tiledTextureManagerDesc)
+    TiledTextureManagerImpl::TiledTextureManagerImpl(const TiledTextureManagerDesc& tiledTextureManagerDesc, TileAllocator* pSharedTileAllocator)
         : m_tiledTextureManagerDesc(tiledTextureManagerDesc)
         , m_totalTilesNum(0)
         , m_activeTilesNum(0)
         , m_config()
     {
-        m_tileAllocator = std::make_shared<TileAllocator>(tiledTextureManagerDesc.heapTilesCapacity, 65536);
+        // A shared allocator is owned by the application
+        if (pSharedTileAllocator)
+            m_tileAllocator = std::shared_ptr<TileAllocator>(pSharedTileAllocator, [](TileAllocator*) {});
+        else
+            m_tileAllocator = std::make_shared<TileAllocator>(65536, tiledTextureManagerDesc.tilePlacementPolicy);
+
+        m_ownerId = m_tileAllocator->AttachOwner(this);
+
+        // Bounded managers allocate their storage up front
+        if (tiledTextureManagerDesc.maxTexturesNum)
+        {
+            m_tiledTextures.reserve(tiledTextureManagerDesc.maxTexturesNum);
+            m_tiledTextureSharedDescs.reserve(tiledTextureManagerDesc.maxTexturesNum);
+            m_tiledTextureFreelist.reserve(tiledTextureManagerDesc.maxTexturesNum);
+            m_texturesWithPendingWork.reserve(tiledTextureManagerDesc.maxTexturesNum);
+        }
+
+        if (tiledTextureManagerDesc.maxTilesNum)
+        {
+            m_requestedQueue.Reserve(tiledTextureManagerDesc.maxTilesNum);
+            m_standbyQueue.Reserve(tiledTextureManagerDesc.maxTilesNum);
+            m_reservedHeapTiles.Reserve(tiledTextureManagerDesc.maxTilesNum);
+            m_pendingTileMoves.Reserve(tiledTextureManagerDesc.maxTilesNum);
+            GetMemoryPool(0);
+            m_tileRanges.reserve(tiledTextureManagerDesc.maxTilesNum);
+            m_moveTiles.reserve(tiledTextureManagerDesc.maxTilesNum);
+            m_moveLifetimeClasses.reserve(tiledTextureManagerDesc.maxTilesNum);
+            m_moveDstAllocations.reserve(tiledTextureManagerDesc.maxTilesNum);
+            m_pendingTileBits.Reserve(tiledTextureManagerDesc.maxTilesNum);
+            m_requestedBits.Reserve(tiledTextureManagerDesc.maxTilesNum);
+
+            // Every tile can be unmapped and mapped again within a frame
+            for (auto& tileBindings : m_tileBindings)
+                tileBindings.reserve(2 * tiledTextureManagerDesc.maxTilesNum);
+        }
+
+        if (tiledTextureManagerDesc.maxHeapsNum)
+        {
+            m_tileAllocator->Reserve(tiledTextureManagerDesc.maxHeapsNum, tiledTextureManagerDesc.heapTilesCapacity);
+            m_heapTiles.reserve(tiledTextureManagerDesc.heapTilesCapacity);
+            m_moveHeapIds.reserve(tiledTextureManagerDesc.maxHeapsNum);
+        }
     }
 
     TiledTextureManagerImpl::~TiledTextureManagerImpl()
     {
+        // Return the tiles to a shared allocator which outlives this manager, shared heap tiles only once
+        for (auto& sharedTile : m_sharedTiles)
+        {
+            m_tileAllocator->FreeTile(sharedTile.second.allocation);
+            for (auto& textureAndTile : sharedTile.second.tiles)
+                m_tiledTextures[textureAndTile.textureId].tileAllocations[textureAndTile.tileIndex] = {};
+        }
+
+        for (auto& tiledTextureState : m_tiledTextures)
+            for (uint32_t tileIndex = 0; tileIndex < (uint32_t)tiledTextureState.tileAllocations.size(); ++tileIndex)
+                if (!IsConstantTile(tiledTextureState, tileIndex))
+                    m_tileAllocator->FreeTile(tiledTextureState.tileAllocations[tileIndex]);
+
+        m_pendingTileMoves.ForEach([this](const TextureAndTile&, TileAllocation dstAllocation)
+            {
+                m_tileAllocator->FreeTile(dstAllocation);
+            });
 
+        m_tileAllocator->DetachOwner(m_ownerId);
     }
 
     void TiledTextureManagerImpl::SetConfig(const TiledTextureManagerConfig& config)
@@ -37,8 +98,21 @@ namespace rtxts
         m_config = config;
     }
 
-    void TiledTextureManagerImpl::AddTiledTexture(const TiledTextureDesc& tiledTextureDesc, uint32_t& textureId)
+    TiledTextureManagerResult TiledTextureManagerImpl::AddTiledTexture(const TiledTextureDesc& tiledTextureDesc, uint32_t& textureId)
     {
+        if (m_tiledTextureManagerDesc.maxTexturesNum && m_tiledTextureFreelist.empty() && m_tiledTextures.size() >= m_tiledTextureManagerDesc.maxTexturesNum)
+            return TiledTextureManagerResult_TooManyTextures;
+
+        if (m_tiledTextureManagerDesc.maxTilesNum)
+        {
+            uint32_t tilesNum = tiledTextureDesc.packedMipLevelsNum ? tiledTextureDesc.packedTilesNum : 0;
+            for (uint32_t i = 0; i < tiledTextureDesc.regularMipLevelsNum; ++i)
+                tilesNum += tiledTextureDesc.tiledLevelDescs[i].widthInTiles * tiledTextureDesc.tiledLevelDescs[i].heightInTiles;
+
+            if (m_totalTilesNum + tilesNum > m_tiledTextureManagerDesc.maxTilesNum)
+                return TiledTextureManagerResult_TooManyTiles;
+        }
+
         if (!m_tiledTextureFreelist.empty())
         {
             textureId = m_tiledTextureFreelist.back();
@@ -55,6 +129,8 @@ namespace rtxts
         TiledTextureState& tiledTextureState = m_tiledTextures[textureId];
         const TiledTextureSharedDesc& desc = m_tiledTextureSharedDescs[tiledTextureState.descIndex];
         m_totalTilesNum += desc.packedTilesNum + desc.regularTilesNum;
+
+        return TiledTextureManagerResult_Ok;
     }
 
     void TiledTextureManagerImpl::RemoveTiledTexture(uint32_t textureId)
@@ -63,40 +139,125 @@ namespace rtxts
         const TiledTextureSharedDesc& desc = m_tiledTextureSharedDescs[tiledTextureState.descIndex];
 
         // Free all allocated tiles
-        for (auto& tileAllocation : tiledTextureState.tileAllocations)
+        MemoryPoolState& memoryPool = GetMemoryPool(tiledTextureState.poolId);
+        for (uint32_t tileIndex = 0; tileIndex < (uint32_t)tiledTextureState.tileAllocations.size(); ++tileIndex)
         {
-            m_tileAllocator->FreeTile(tileAllocation);
+            TileAllocation& tileAllocation = tiledTextureState.tileAllocations[tileIndex];
+            if (tileAllocation.IsValid() && !IsConstantTile(tiledTextureState, tileIndex))
+            {
+                if (FindSharedTile(textureId, tileIndex))
+                    FreeSharedTile(textureId, tileIndex);
+                else
+                {
+                    m_tileAllocator->FreeTile(tileAllocation);
+                    memoryPool.allocatedTilesNum--;
+                }
+            }
             m_activeTilesNum--;
         }
 
-        // Erase tiles which may possibly be in the requested or standby queues
-        for (uint32_t tileIndex = 0; tileIndex < desc.regularTilesNum; ++tileIndex)
+        TileCategoryState* pTileCategory = tiledTextureState.categoryId ? &GetTileCategory(tiledTextureState.categoryId) : nullptr;
+        if (pTileCategory)
+            pTileCategory->allocatedTilesNum -= tiledTextureState.allocatedUnpackedTilesNum;
+
+        if (m_pendingTileMoves.size())
+        {
+            for (uint32_t tileIndex = 0; tileIndex < desc.regularTilesNum + desc.packedTilesNum; ++tileIndex)
+                CancelTileMove(textureId, tileIndex);
+        }
+
+        // Erase tiles which may possibly be in the requested, standby or reserved heap queues, packed tiles wait in the requested queue until they are allocated
+        for (uint32_t tileIndex = 0; tileIndex < desc.regularTilesNum + desc.packedTilesNum; ++tileIndex)
         {
             m_requestedQueue.erase(TextureAndTile{textureId, tileIndex});
+            m_reservedHeapTiles.erase(TextureAndTile{textureId, tileIndex});
             m_standbyQueue.erase(TextureAndTile{textureId, tileIndex});
+            memoryPool.standbyQueue.erase(TextureAndTile{textureId, tileIndex});
+            memoryPool.mappedQueue.erase(TextureAndTile{textureId, tileIndex});
+            if (pTileCategory && tileIndex < desc.regularTilesNum)
+                pTileCategory->standbyQueue.erase(TextureAndTile{textureId, tileIndex});
+            if (tileIndex < desc.regularTilesNum)
+                tiledTextureState.standbyQueue.erase(tileIndex);
         }
 
         m_totalTilesNum -= desc.packedTilesNum + desc.regularTilesNum;
+        m_requestedTilesNum -= tiledTextureState.requestedTilesNum;
 
-        tiledTextureState = {};
+        if (tiledTextureState.hasPendingWork)
+            m_texturesWithPendingWork.erase(std::find(m_texturesWithPendingWork.begin(), m_texturesWithPendingWork.end(), textureId));
+
+        ResetTiledTextureState(tiledTextureState);
 
         m_tiledTextureFreelist.push_back(textureId);
     }
 
+    void TiledTextureManagerImpl::SetTextureCategory(uint32_t textureId, uint32_t categoryId)
+    {
+        TiledTextureState& tiledTextureState = m_tiledTextures[textureId];
+        if (tiledTextureState.categoryId == categoryId)
+            return;
+
+        const TiledTextureSharedDesc& desc = m_tiledTextureSharedDescs[tiledTextureState.descIndex];
+
+        // Move the tile accounting of the texture from the previous category to the new one.
+        // GetTileCategory() may grow the categories, so the new category is added before taking pointers to both
+        if (categoryId)
+            GetTileCategory(categoryId);
+        TileCategoryState* pPrevCategory = tiledTextureState.categoryId ? &GetTileCategory(tiledTextureState.categoryId) : nullptr;
+        TileCategoryState* pNewCategory = categoryId ? &GetTileCategory(categoryId) : nullptr;
+        if (pPrevCategory)
+            pPrevCategory->allocatedTilesNum -= tiledTextureState.allocatedUnpackedTilesNum;
+        if (pNewCategory)
+            pNewCategory->allocatedTilesNum += tiledTextureState.allocatedUnpackedTilesNum;
+
+        if (tiledTextureState.standbyUnpackedTilesNum)
+        {
+            for (uint32_t tileIndex = 0; tileIndex < desc.regularTilesNum; ++tileIndex)
+            {
+                if (tiledTextureState.tileStates[tileIndex] != TileState_Standby)
+                    continue;
+
+                if (pPrevCategory)
+                    pPrevCategory->standbyQueue.erase(TextureAndTile{textureId, tileIndex});
+                if (pNewCategory)
+                    pNewCategory->standbyQueue.push_back(TextureAndTile{textureId, tileIndex});
+            }
+        }
+
+        tiledTextureState.categoryId = categoryId;
+    }
+
+    void TiledTextureManagerImpl::SetTextureQuota(uint32_t textureId, const TileQuota& quota)
+    {
+        m_tiledTextures[textureId].quota = quota;
+    }
+
+    void TiledTextureManagerImpl::SetCategoryQuota(uint32_t categoryId, const TileQuota& quota)
+    {
+        // Category 0 holds uncategorized textures and is only limited by the global standby target
+        if (!categoryId)
+            return;
+
+        GetTileCategory(categoryId).quota = quota;
+    }
+
+    void TiledTextureManagerImpl::SetMemoryPool(uint32_t poolId, const MemoryPoolDesc& memoryPoolDesc)
+    {
+        GetMemoryPool(poolId).desc = memoryPoolDesc;
+    }
+
     void TiledTextureManagerImpl::UpdateWithSamplerFeedback(uint32_t textureId, SamplerFeedbackDesc& samplerFeedbackDesc, float timestamp, float timeout)
     {
         TiledTextureState& tiledTextureState = m_tiledTextures[textureId];
         const TiledTextureSharedDesc& desc = m_tiledTextureSharedDescs[tiledTextureState.descIndex];
 
-        tiledTextureState.requestedTilesNum = desc.packedTilesNum;
         if (desc.regularMipLevelsNum == 0)
             return;
 
-        tiledTextureState.tilesToMap.clear();
-        tiledTextureState.tilesToUnmap.clear();
-
-        BitArray requestedBits;
+        // Pending tiles are kept until they are retrieved, they may have been queued outside of the feedback update, e.g. by CommitHeap()
+        BitArray& requestedBits = m_requestedBits;
         requestedBits.Init(desc.regularTilesNum + desc.packedTilesNum);
+        requestedBits.Clear();
         // Mark tiles covering packed mip levels
         for (uint32_t packedTileIndex = 0; packedTileIndex < desc.packedTilesNum; ++packedTileIndex)
             requestedBits.SetBit(desc.regularTilesNum + packedTileIndex);
@@ -153,15 +314,14 @@ namespace rtxts
         const TiledTextureSharedDesc& primaryDesc = m_tiledTextureSharedDescs[primaryTextureState.descIndex];
         const TiledTextureSharedDesc& followerDesc = m_tiledTextureSharedDescs[followerTextureState.descIndex];
 
-        BitArray requestedBits;
+        BitArray& requestedBits = m_requestedBits;
         requestedBits.Init(followerDesc.regularTilesNum + followerDesc.packedTilesNum);
+        requestedBits.Clear();
 
         // Mark tiles covering packed mip levels
         for (uint32_t packedTileIndex = 0; packedTileIndex < followerDesc.packedTilesNum; ++packedTileIndex)
             requestedBits.SetBit(followerDesc.regularTilesNum + packedTileIndex);
 
-        followerTextureState.requestedTilesNum = followerDesc.packedTilesNum;
-
         uint32_t firstTileIndex = UINT32_MAX;
 
         // Loop over all currently being requested tiles in the primary texture
@@ -200,7 +360,6 @@ namespace rtxts
                     if (followerLeft < primaryRight && followerRight > primaryLeft &&
                         followerTop < primaryBottom && followerBottom > primaryTop)
                     {
-                        followerTextureState.requestedTilesNum++;
                         requestedBits.SetBit(followerTileIndex);
                         firstTileIndex = std::min(firstTileIndex, followerTileIndex);
                     }
@@ -211,36 +370,368 @@ namespace rtxts
         UpdateTiledTexture(followerTextureId, requestedBits, firstTileIndex, timeStamp, timeout);
     }
 
-    uint32_t TiledTextureManagerImpl::GetNumDesiredHeaps()
+    uint32_t TiledTextureManagerImpl::GetDesiredTilesNum() const
     {
-        // Sum the number of active actively requested tiles in all textures
+        // Actively requested tiles in all textures plus the configurable number of standby tiles, of all managers sharing the heaps
         uint32_t numTiles = 0;
-        for (auto& texture : m_tiledTextures)
+        for (auto pOwner : m_tileAllocator->GetOwners())
         {
-            numTiles += texture.requestedTilesNum;
+            if (pOwner)
+                numTiles += static_cast<const TiledTextureManagerImpl*>(pOwner)->m_requestedTilesNum + static_cast<const TiledTextureManagerImpl*>(pOwner)->m_config.numExtraStandbyTiles;
         }
 
-        // Add the configurable number of standby tiles
-        numTiles += m_config.numExtraStandbyTiles;
+        return numTiles;
+    }
+
+    uint32_t TiledTextureManagerImpl::GetNumDesiredHeaps()
+    {
+        return GetHeapPlan().desiredHeapsNum;
+    }
+
+    HeapPlan TiledTextureManagerImpl::GetHeapPlan()
+    {
+        HeapPlannerState& planner = m_heapPlanner;
+        uint32_t demandTilesNum = GetDesiredTilesNum();
+
+        // Advance the level and trend of the demand once per update timestamp, so querying several times per frame doesn't skew them
+        if (!planner.isInitialized)
+        {
+            planner.isInitialized = true;
+            planner.demandLevel = float(demandTilesNum);
+            planner.demandTrend = 0.0f;
+            planner.lastStepTime = m_latestTimeStamp;
+            planner.lastChangeTime = m_latestTimeStamp;
+            planner.desiredTilesNum = demandTilesNum;
+        }
+        else if (m_latestTimeStamp != planner.lastStepTime)
+        {
+            float prevDemandLevel = planner.demandLevel;
+            planner.demandLevel = m_config.heapDemandSmoothing * float(demandTilesNum) + (1.0f - m_config.heapDemandSmoothing) * (prevDemandLevel + planner.demandTrend);
+            planner.demandTrend = m_config.heapDemandTrendSmoothing * (planner.demandLevel - prevDemandLevel) + (1.0f - m_config.heapDemandTrendSmoothing) * planner.demandTrend;
+            planner.lastStepTime = m_latestTimeStamp;
+        }
+
+        float predictedTilesNum = std::max(planner.demandLevel + planner.demandTrend * float(m_config.heapGrowAheadSteps), 0.0f);
+
+        if (demandTilesNum > planner.desiredTilesNum)
+        {
+            // Grow right away, requests would fail otherwise
+            planner.desiredTilesNum = demandTilesNum;
+            planner.lastChangeTime = m_latestTimeStamp;
+        }
+        else
+        {
+            // Shrink once the demand stays low, both now and as predicted, and the capacity has lived long enough
+            uint32_t shrinkTilesNum = std::max(demandTilesNum, uint32_t(std::ceil(std::max(planner.demandLevel, predictedTilesNum))));
+            if (float(shrinkTilesNum) < float(planner.desiredTilesNum) * (1.0f - m_config.heapShrinkHysteresis) &&
+                m_latestTimeStamp - planner.lastChangeTime >= m_config.heapMinLifetime)
+            {
+                planner.desiredTilesNum = shrinkTilesNum;
+                planner.lastChangeTime = m_latestTimeStamp;
+            }
+        }
+
+        // Never plan for more heap memory than the budget
+        planner.desiredTilesNum = std::min(planner.desiredTilesNum, m_tileAllocator->GetBudgetTilesNum());
+        predictedTilesNum = std::min(predictedTilesNum, float(m_tileAllocator->GetBudgetTilesNum()));
 
-        // Calculate the number of required heaps
         uint32_t tilesPerHeap = m_tiledTextureManagerDesc.heapTilesCapacity;
-        uint32_t numRequiredHeaps = (numTiles + tilesPerHeap - 1) / tilesPerHeap;
-        return numRequiredHeaps;
+
+        HeapPlan heapPlan = {};
+        heapPlan.demandTilesNum = demandTilesNum;
+        heapPlan.predictedTilesNum = uint32_t(std::ceil(predictedTilesNum));
+        heapPlan.desiredTilesNum = planner.desiredTilesNum;
+        heapPlan.desiredHeapsNum = (planner.desiredTilesNum + tilesPerHeap - 1) / tilesPerHeap;
+        if (predictedTilesNum > float(planner.desiredTilesNum) * (1.0f + m_config.heapGrowHysteresis))
+        {
+            heapPlan.growAheadTilesNum = heapPlan.predictedTilesNum - planner.desiredTilesNum;
+            heapPlan.growAheadHeapsNum = (heapPlan.predictedTilesNum + tilesPerHeap - 1) / tilesPerHeap - heapPlan.desiredHeapsNum;
+        }
+
+        return heapPlan;
+    }
+
+    void TiledTextureManagerImpl::GetDesiredHeapCapacities(std::vector<uint32_t>& heapTilesNums)
+    {
+        heapTilesNums.clear();
+
+        uint32_t numTiles = GetHeapPlan().desiredTilesNum;
+        uint32_t totalTilesNum = m_tileAllocator->GetTotalTilesNum();
+        uint32_t minHeapTilesNum = m_tiledTextureManagerDesc.heapTilesCapacity;
+        uint32_t maxHeapTilesNum = std::max(minHeapTilesNum, m_tiledTextureManagerDesc.maxHeapTilesCapacity);
+
+        while (totalTilesNum < numTiles)
+        {
+            // Grow by doubling the total capacity until heaps reach the maximum size
+            uint32_t heapTilesNum = minHeapTilesNum;
+            while (heapTilesNum * 2 <= maxHeapTilesNum && heapTilesNum * 2 <= totalTilesNum)
+                heapTilesNum *= 2;
+
+            // Use the smallest size class which covers the remaining tiles for the last heap
+            uint32_t remainingTilesNum = numTiles - totalTilesNum;
+            while (heapTilesNum > minHeapTilesNum && heapTilesNum / 2 >= remainingTilesNum)
+                heapTilesNum /= 2;
+
+            heapTilesNums.push_back(heapTilesNum);
+            totalTilesNum += heapTilesNum;
+        }
     }
 
-    void TiledTextureManagerImpl::AddHeap(uint32_t heapId)
+    TiledTextureManagerResult TiledTextureManagerImpl::AddHeap(uint32_t heapId, uint32_t heapTilesNum)
     {
-        m_tileAllocator->AddHeap(heapId);
+        if (m_tiledTextureManagerDesc.maxHeapsNum && m_tileAllocator->GetHeapsNum() >= m_tiledTextureManagerDesc.maxHeapsNum)
+            return TiledTextureManagerResult_TooManyHeaps;
+
+        m_tileAllocator->AddHeap(heapId, heapTilesNum ? heapTilesNum : m_tiledTextureManagerDesc.heapTilesCapacity);
+
+        return TiledTextureManagerResult_Ok;
+    }
+
+    TiledTextureManagerResult TiledTextureManagerImpl::ReserveHeap(uint32_t heapId, uint32_t heapTilesNum)
+    {
+        if (m_tiledTextureManagerDesc.maxHeapsNum && m_tileAllocator->GetHeapsNum() >= m_tiledTextureManagerDesc.maxHeapsNum)
+            return TiledTextureManagerResult_TooManyHeaps;
+
+        m_tileAllocator->AddHeap(heapId, heapTilesNum ? heapTilesNum : m_tiledTextureManagerDesc.heapTilesCapacity, true);
+
+        return TiledTextureManagerResult_Ok;
+    }
+
+    void TiledTextureManagerImpl::CommitHeap(uint32_t heapId)
+    {
+        if (!m_tileAllocator->IsReservedHeap(heapId))
+            return;
+
+        // Hand out the tiles which were allocated while the heap was being created, in all managers sharing the heap
+        for (auto pOwner : m_tileAllocator->GetOwners())
+        {
+            if (!pOwner)
+                continue;
+
+            // Tiles of other reserved heaps are rotated back into the queue in their order
+            TiledTextureManagerImpl* pManager = static_cast<TiledTextureManagerImpl*>(pOwner);
+            for (size_t i = pManager->m_reservedHeapTiles.size(); i > 0; --i)
+            {
+                TextureAndTile textureAndTile = pManager->m_reservedHeapTiles.front();
+                pManager->m_reservedHeapTiles.pop_front();
+
+                TiledTextureState& tiledTextureState = pManager->m_tiledTextures[textureAndTile.textureId];
+                assert(textureAndTile.tileIndex < tiledTextureState.tileAllocations.size());
+                if (tiledTextureState.tileAllocations[textureAndTile.tileIndex].heapId != heapId)
+                {
+                    pManager->m_reservedHeapTiles.push_back(textureAndTile);
+                    continue;
+                }
+
+                assert(tiledTextureState.tileStates[textureAndTile.tileIndex] == TileState_Allocated || tiledTextureState.tileStates[textureAndTile.tileIndex] == TileState_Standby);
+                tiledTextureState.tilesToMap.push_back(textureAndTile.tileIndex);
+                pManager->MarkPendingWork(textureAndTile.textureId);
+            }
+        }
+
+        m_tileAllocator->CommitHeap(heapId);
     }
 
     void TiledTextureManagerImpl::RemoveHeap(uint32_t heapId)
     {
+        // Release tiles which still live in the heap so no texture keeps referencing it
+        ReleaseHeapTiles(heapId);
+
         m_tileAllocator->RemoveHeap(heapId);
     }
 
+    void TiledTextureManagerImpl::ReleaseHeapTiles(uint32_t heapId, bool standbyOnly)
+    {
+        TiledHeap* pHeap = m_tileAllocator->GetHeap(m_tileAllocator->GetHeapHandle(heapId));
+        if (!pHeap || pHeap->IsEmpty())
+            return;
+
+        auto& heapTiles = m_heapTiles;
+        heapTiles.clear();
+        for (uint32_t heapTileIndex : pHeap->GetUsedTileBits())
+            heapTiles.push_back(std::make_pair(pHeap->GetOwnerIds()[heapTileIndex], pHeap->GetAllocations()[heapTileIndex]));
+
+        for (auto& heapTile : heapTiles)
+            static_cast<TiledTextureManagerImpl*>(m_tileAllocator->GetOwners()[heapTile.first])->ReleaseHeapTile(heapId, heapTile.second, standbyOnly);
+    }
+
+    void TiledTextureManagerImpl::ReleaseHeapTile(uint32_t heapId, const TextureAndTile& textureAndTile, bool standbyOnly)
+    {
+        TiledTextureState& tiledTextureState = m_tiledTextures[textureAndTile.textureId];
+
+        if (tiledTextureState.tileAllocations[textureAndTile.tileIndex].heapId != heapId)
+        {
+            // Destination slot of a pending move, the tile stays where it is and the slot is freed so the heap can become empty
+            if (!standbyOnly)
+                CancelTileMove(textureAndTile.textureId, textureAndTile.tileIndex);
+            return;
+        }
+
+        // Tiles sharing the heap tile are released together, with standbyOnly only if none of them is in use
+        SharedTileState* pSharedTile = FindSharedTile(textureAndTile.textureId, textureAndTile.tileIndex);
+        if (pSharedTile)
+        {
+            auto& sharedTiles = m_sharedTilesScratch;
+            sharedTiles = pSharedTile->tiles;
+            bool isStandbyOnly = std::all_of(sharedTiles.begin(), sharedTiles.end(), [this](const TextureAndTile& sharedTile)
+                {
+                    return m_tiledTextures[sharedTile.textureId].tileStates[sharedTile.tileIndex] == TileState_Standby;
+                });
+            if (standbyOnly && !isStandbyOnly)
+                return;
+
+            for (auto& sharedTile : sharedTiles)
+                ReleaseTile(sharedTile);
+        }
+        else if (!standbyOnly || tiledTextureState.tileStates[textureAndTile.tileIndex] == TileState_Standby)
+        {
+            ReleaseTile(textureAndTile);
+        }
+    }
+
+    void TiledTextureManagerImpl::ReleaseTile(const TextureAndTile& textureAndTile)
+    {
+        TiledTextureState& tiledTextureState = m_tiledTextures[textureAndTile.textureId];
+        const TiledTextureSharedDesc& desc = m_tiledTextureSharedDescs[tiledTextureState.descIndex];
+
+        if (tiledTextureState.tileStates[textureAndTile.tileIndex] == TileState_Allocated)
+        {
+            // The tile was never mapped, it only has to be taken off the list of tiles to map
+            auto& tilesToMap = tiledTextureState.tilesToMap;
+            tilesToMap.erase(std::remove(tilesToMap.begin(), tilesToMap.end(), textureAndTile.tileIndex), tilesToMap.end());
+        }
+
+        TransitionTile(textureAndTile.textureId, textureAndTile.tileIndex, TileState_Free);
+
+        // Tiles which are still needed are requested again to get a slot in another heap
+        bool isRequested = tiledTextureState.requestedBits.GetBitsNum() && tiledTextureState.requestedBits.GetBit(textureAndTile.tileIndex);
+        if (textureAndTile.tileIndex >= desc.regularTilesNum || isRequested)
+            TransitionTile(textureAndTile.textureId, textureAndTile.tileIndex, TileState_Requested);
+    }
+
+    bool TiledTextureManagerImpl::BeginEvacuateHeap(uint32_t heapId, std::vector<TileMove>& tileMoves)
+    {
+        tileMoves.clear();
+
+        TiledHeap* pHeap = m_tileAllocator->GetHeap(m_tileAllocator->GetHeapHandle(heapId));
+        if (!pHeap || m_tileAllocator->IsReservedHeap(heapId))
+            return false;
+
+        m_tileAllocator->ExcludeHeap(heapId);
+
+        // Tiles of other managers sharing the heap are moved when those managers evacuate it
+        auto& heapTiles = m_moveTiles;
+        heapTiles.clear();
+        for (uint32_t heapTileIndex : pHeap->GetUsedTileBits())
+        {
+            if (pHeap->GetOwnerIds()[heapTileIndex] == m_ownerId)
+                heapTiles.push_back(pHeap->GetAllocations()[heapTileIndex]);
+        }
+
+        bool allTilesMoved = true;
+        for (auto& textureAndTile : heapTiles)
+        {
+            // Skip destination slots reserved for other moves and tiles which are already being moved
+            TiledTextureState& tiledTextureState = m_tiledTextures[textureAndTile.textureId];
+            TileAllocation& tileAllocation = tiledTextureState.tileAllocations[textureAndTile.tileIndex];
+            if (tileAllocation.heapId != heapId || m_pendingTileMoves.find(textureAndTile))
+                continue;
+
+            const TiledTextureSharedDesc& desc = m_tiledTextureSharedDescs[tiledTextureState.descIndex];
+            TileAllocation dstAllocation = m_tileAllocator->AllocateTile(m_ownerId, textureAndTile.textureId, textureAndTile.tileIndex, GetTileLifetimeClass(desc, textureAndTile.tileIndex));
+            if (!dstAllocation.IsValid())
+            {
+                allTilesMoved = false;
+                continue;
+            }
+
+            auto& tilesToMap = tiledTextureState.tilesToMap;
+            if (tiledTextureState.tileStates[textureAndTile.tileIndex] == TileState_Allocated && std::find(tilesToMap.begin(), tilesToMap.end(), textureAndTile.tileIndex) != tilesToMap.end())
+            {
+                // The tile has not been handed out for mapping yet and holds no data, so it can switch to the new slot right away
+                m_tileAllocator->FreeTile(tileAllocation);
+                tileAllocation = dstAllocation;
+                SharedTileState* pSharedTile = FindSharedTile(textureAndTile.textureId, textureAndTile.tileIndex);
+                if (pSharedTile)
+                    UpdateSharedTileAllocation(*pSharedTile, dstAllocation);
+                continue;
+            }
+
+            m_pendingTileMoves.insert(textureAndTile, dstAllocation);
+            tileMoves.push_back(TileMove{textureAndTile.textureId, textureAndTile.tileIndex, tileAllocation, dstAllocation});
+        }
+
+        return allTilesMoved;
+    }
+
+    void TiledTextureManagerImpl::CancelEvacuateHeap(uint32_t heapId)
+    {
+        m_tileAllocator->IncludeHeap(heapId);
+
+        // Tiles keep their slot in the heap, the destination slots reserved for them are freed
+        auto& movedTiles = m_moveTiles;
+        movedTiles.clear();
+        m_pendingTileMoves.ForEach([this, heapId, &movedTiles](const TextureAndTile& textureAndTile, const TileAllocation&)
+            {
+                if (m_tiledTextures[textureAndTile.textureId].tileAllocations[textureAndTile.tileIndex].heapId == heapId)
+                    movedTiles.push_back(textureAndTile);
+            });
+
+        for (auto& textureAndTile : movedTiles)
+            CancelTileMove(textureAndTile.textureId, textureAndTile.tileIndex);
+    }
+
+    void TiledTextureManagerImpl::CompleteTileMoves(const std::vector<TileMove>& tileMoves)
+    {
+        for (auto& tileMove : tileMoves)
+        {
+            // Moves of tiles which were freed in the meantime have already been cancelled
+            TileAllocation* pDstAllocation = m_pendingTileMoves.find(TextureAndTile{tileMove.textureId, tileMove.tileIndex});
+            if (!pDstAllocation)
+                continue;
+
+            TileAllocation& tileAllocation = m_tiledTextures[tileMove.textureId].tileAllocations[tileMove.tileIndex];
+            m_tileAllocator->FreeTile(tileAllocation);
+            tileAllocation = *pDstAllocation;
+            m_pendingTileMoves.erase(TextureAndTile{tileMove.textureId, tileMove.tileIndex});
+
+            SharedTileState* pSharedTile = FindSharedTile(tileMove.textureId, tileMove.tileIndex);
+            if (pSharedTile)
+                UpdateSharedTileAllocation(*pSharedTile, tileAllocation);
+        }
+    }
+
     void TiledTextureManagerImpl::TrimStandbyTiles()
     {
+        // Quotas may have been lowered since the tiles entered standby, evict the LRU tiles of categories and textures over their quotas first
+        for (auto& tileCategory : m_tileCategories)
+        {
+            while (tileCategory.standbyQueue.size() > 0 && (tileCategory.standbyQueue.size() > tileCategory.quota.maxStandbyTilesNum || tileCategory.allocatedTilesNum > tileCategory.quota.maxActiveTilesNum))
+            {
+                TextureAndTile textureAndTile = tileCategory.standbyQueue.front();
+                TransitionTile(textureAndTile.textureId, textureAndTile.tileIndex, TileState_Free);
+            }
+        }
+
+        for (auto& memoryPool : m_memoryPools)
+        {
+            while (memoryPool.standbyQueue.size() > 0 && (memoryPool.standbyQueue.size() > memoryPool.desc.maxStandbyTilesNum || memoryPool.allocatedTilesNum > memoryPool.desc.maxTilesNum))
+            {
+                TextureAndTile textureAndTile = memoryPool.standbyQueue.front();
+                TransitionTile(textureAndTile.textureId, textureAndTile.tileIndex, TileState_Free);
+            }
+        }
+
+        for (uint32_t textureId = 0; textureId < (uint32_t)m_tiledTextures.size(); ++textureId)
+        {
+            const TiledTextureState& tiledTextureState = m_tiledTextures[textureId];
+            while (tiledTextureState.standbyUnpackedTilesNum > tiledTextureState.quota.maxStandbyTilesNum || tiledTextureState.allocatedUnpackedTilesNum > tiledTextureState.quota.maxActiveTilesNum)
+            {
+                if (!EvictTextureStandbyTile(textureId))
+                    break;
+            }
+        }
+
         while (m_standbyQueue.size() > m_config.numExtraStandbyTiles)
         {
             TextureAndTile textureAndTile = m_standbyQueue.front();
@@ -248,14 +739,70 @@ namespace rtxts
         }
     }
 
+    void TiledTextureManagerImpl::SetMemoryBudget(uint64_t budgetInBytes)
+    {
+        uint64_t budgetTilesNum = budgetInBytes / m_tileAllocator->GetTileSizeInBytes();
+        m_tileAllocator->SetBudgetTilesNum((uint32_t)std::min(budgetTilesNum, (uint64_t)UINT32_MAX));
+    }
+
+    void TiledTextureManagerImpl::EmergencyTrim(uint64_t bytesToFree, std::vector<uint32_t>& heapIds)
+    {
+        heapIds.clear();
+
+        uint32_t tileSizeInBytes = m_tileAllocator->GetTileSizeInBytes();
+        uint64_t tilesToFreeNum = (bytesToFree + tileSizeInBytes - 1) / tileSizeInBytes;
+        uint32_t totalTilesNum = m_tileAllocator->GetTotalTilesNum();
+        if (!tilesToFreeNum)
+            return;
+
+        // Pick the heaps to release first so no tile is allocated in them from now on
+        uint32_t releasedTilesNum = m_tileAllocator->ExcludeHeapsToTrim((uint32_t)std::min(tilesToFreeNum, (uint64_t)totalTilesNum), heapIds);
+        uint32_t remainingTilesNum = totalTilesNum - releasedTilesNum;
+
+        // Standby tiles in the released heaps are dropped first, they would be freed with the heaps anyway
+        for (uint32_t heapId : heapIds)
+            ReleaseHeapTiles(heapId, true);
+
+        // Make the allocated tiles fit in the remaining heaps, other standby tiles first regardless of pool guarantees
+        while (m_tileAllocator->GetAllocatedTilesNum() > remainingTilesNum)
+        {
+            if (!EvictStandbyTile(UINT32_MAX, true))
+                break;
+        }
+
+        if (m_tileAllocator->GetAllocatedTilesNum() > remainingTilesNum)
+            EvictMappedTiles(m_tileAllocator->GetAllocatedTilesNum() - remainingTilesNum);
+
+        // Tiles left in the released heaps are freed, the ones still needed are requested again to get a slot in the remaining heaps
+        for (uint32_t heapId : heapIds)
+            ReleaseHeapTiles(heapId);
+    }
+
     void TiledTextureManagerImpl::AllocateRequestedTiles()
     {
-        while (m_requestedQueue.size() > 0)
+        // Tiles of textures which are over their quota are moved to the back of the queue so they don't block other textures
+        size_t deferredTilesNum = 0;
+        bool isHeapFull = false;
+        while (m_requestedQueue.size() > deferredTilesNum)
         {
-            auto& textureAndTile = m_requestedQueue.front();
+            TextureAndTile textureAndTile = m_requestedQueue.front();
+            if (!EnforceActiveQuota(textureAndTile.textureId, textureAndTile.tileIndex) || (isHeapFull && !IsPoolWithinGuarantee(m_tiledTextures[textureAndTile.textureId].poolId)))
+            {
+                m_requestedQueue.pop_front();
+                m_requestedQueue.push_back(textureAndTile);
+                deferredTilesNum++;
+                continue;
+            }
+
             bool allocSuccess = TransitionTile(textureAndTile.textureId, textureAndTile.tileIndex, TileState_Allocated);
             if (!allocSuccess)
-                break; // Failed to allocate tile, probably no free space
+            {
+                // Failed to allocate tile, probably no free space. Pools within their guarantee can still take back borrowed tiles
+                if (IsPoolWithinGuarantee(m_tiledTextures[textureAndTile.textureId].poolId) || !HasPoolWithinGuarantee())
+                    break;
+                isHeapFull = true;
+                continue;
+            }
             m_requestedQueue.pop_front();
         }
     }
@@ -264,28 +811,245 @@ namespace rtxts
     {
         tileIndices.clear();
         TiledTextureState& tiledTextureState = m_tiledTextures[textureId];
+        ReconcilePendingTiles(tiledTextureState);
 
         tileIndices = tiledTextureState.tilesToMap;
         tiledTextureState.tilesToMap.clear();
     }
 
-    void TiledTextureManagerImpl::UpdateTilesMapping(uint32_t textureId, std::vector<uint32_t>& tileIndices)
+    void TiledTextureManagerImpl::UpdateTilesMapping(uint32_t textureId, const std::vector<uint32_t>& tileIndices)
+    {
+        UpdateTilesMapping(textureId, Span<uint32_t>{tileIndices.data(), tileIndices.size()});
+    }
+
+    void TiledTextureManagerImpl::UpdateTilesMapping(uint32_t textureId, Span<uint32_t> tileIndices)
     {
         TiledTextureState& tiledTextureState = m_tiledTextures[textureId];
 
+        // Tiles remapped after their shared heap tile was moved are already mapped
         for (auto& tileIndex : tileIndices)
-            TransitionTile(textureId, tileIndex, TileState_Mapped);
+        {
+            if (tiledTextureState.tileStates[tileIndex] == TileState_Allocated)
+                TransitionTile(textureId, tileIndex, TileState_Mapped);
+        }
     }
 
     void TiledTextureManagerImpl::GetTilesToUnmap(uint32_t textureId, std::vector<uint32_t>& tileIndices)
     {
         tileIndices.clear();
         TiledTextureState& tiledTextureState = m_tiledTextures[textureId];
+        ReconcilePendingTiles(tiledTextureState);
 
         tileIndices = tiledTextureState.tilesToUnmap;
         tiledTextureState.tilesToUnmap.clear();
     }
 
+    Span<uint32_t> TiledTextureManagerImpl::GetTilesToMapSpan(uint32_t textureId)
+    {
+        TiledTextureState& tiledTextureState = m_tiledTextures[textureId];
+        ReconcilePendingTiles(tiledTextureState);
+
+        // Tiles queued from now on go to the back list, which keeps the storage of the previous front list
+        tiledTextureState.tilesToMapFront.swap(tiledTextureState.tilesToMap);
+        tiledTextureState.tilesToMap.clear();
+
+        return Span<uint32_t>{tiledTextureState.tilesToMapFront.data(), tiledTextureState.tilesToMapFront.size()};
+    }
+
+    Span<uint32_t> TiledTextureManagerImpl::GetTilesToUnmapSpan(uint32_t textureId)
+    {
+        TiledTextureState& tiledTextureState = m_tiledTextures[textureId];
+        ReconcilePendingTiles(tiledTextureState);
+
+        tiledTextureState.tilesToUnmapFront.swap(tiledTextureState.tilesToUnmap);
+        tiledTextureState.tilesToUnmap.clear();
+
+        return Span<uint32_t>{tiledTextureState.tilesToUnmapFront.data(), tiledTextureState.tilesToUnmapFront.size()};
+    }
+
+    void TiledTextureManagerImpl::GetTileRangesToMap(uint32_t textureId, std::vector<TileRange>& tileRanges)
+    {
+        TiledTextureState& tiledTextureState = m_tiledTextures[textureId];
+        ReconcilePendingTiles(tiledTextureState);
+
+        BuildTileRanges(tiledTextureState, tiledTextureState.tilesToMap, true, tileRanges);
+        tiledTextureState.tilesToMap.clear();
+
+        // Group the ranges by heap so each heap can be mapped with a single call
+        std::sort(tileRanges.begin(), tileRanges.end(), [](const TileRange& a, const TileRange& b)
+            {
+                if (a.allocation.heapId != b.allocation.heapId)
+                    return a.allocation.heapId < b.allocation.heapId;
+                return a.allocation.heapTileIndex < b.allocation.heapTileIndex;
+            });
+    }
+
+    void TiledTextureManagerImpl::UpdateTilesMapping(uint32_t textureId, const std::vector<TileRange>& tileRanges)
+    {
+        TiledTextureState& tiledTextureState = m_tiledTextures[textureId];
+
+        for (auto& tileRange : tileRanges)
+        {
+            for (uint32_t i = 0; i < tileRange.tilesNum; ++i)
+            {
+                // Ranges retrieved before the tile was moved or allocated again don't map its current allocation
+                uint32_t tileIndex = tileRange.tileIndex + i;
+                if (tileIndex >= (uint32_t)tiledTextureState.tileAllocations.size())
+                    break;
+
+                const TileAllocation& tileAllocation = tiledTextureState.tileAllocations[tileIndex];
+                if (tileAllocation.heapId != tileRange.allocation.heapId || tileAllocation.heapTileIndex != tileRange.allocation.heapTileIndex + i)
+                    continue;
+
+                if (tiledTextureState.tileStates[tileIndex] == TileState_Allocated)
+                    TransitionTile(textureId, tileIndex, TileState_Mapped);
+            }
+        }
+    }
+
+    void TiledTextureManagerImpl::GetTileRangesToUnmap(uint32_t textureId, std::vector<TileRange>& tileRanges)
+    {
+        TiledTextureState& tiledTextureState = m_tiledTextures[textureId];
+        ReconcilePendingTiles(tiledTextureState);
+
+        BuildTileRanges(tiledTextureState, tiledTextureState.tilesToUnmap, false, tileRanges);
+        tiledTextureState.tilesToUnmap.clear();
+    }
+
+    void TiledTextureManagerImpl::GetTexturesWithPendingWork(std::vector<uint32_t>& textureIds)
+    {
+        UpdateTexturesWithPendingWork();
+        textureIds = m_texturesWithPendingWork;
+    }
+
+    // Drops textures whose tiles were retrieved or cancelled since they were marked and sorts the rest by id
+    void TiledTextureManagerImpl::UpdateTexturesWithPendingWork()
+    {
+        auto isDone = [this](uint32_t textureId)
+            {
+                TiledTextureState& tiledTextureState = m_tiledTextures[textureId];
+                if (!tiledTextureState.tilesToMap.empty() || !tiledTextureState.tilesToUnmap.empty())
+                    return false;
+                tiledTextureState.hasPendingWork = false;
+                return true;
+            };
+        m_texturesWithPendingWork.erase(std::remove_if(m_texturesWithPendingWork.begin(), m_texturesWithPendingWork.end(), isDone), m_texturesWithPendingWork.end());
+        std::sort(m_texturesWithPendingWork.begin(), m_texturesWithPendingWork.end());
+    }
+
+    // Lists a texture once its tilesToMap or tilesToUnmap became non-empty
+    void TiledTextureManagerImpl::MarkPendingWork(uint32_t textureId)
+    {
+        TiledTextureState& tiledTextureState = m_tiledTextures[textureId];
+        if (tiledTextureState.hasPendingWork)
+            return;
+
+        tiledTextureState.hasPendingWork = true;
+        m_texturesWithPendingWork.push_back(textureId);
+    }
+
+    const std::vector<TileBinding>& TiledTextureManagerImpl::BuildTileBindings()
+    {
+        m_tileBindingsIndex ^= 1;
+        std::vector<TileBinding>& tileBindings = m_tileBindings[m_tileBindingsIndex];
+        tileBindings.clear();
+
+        UpdateTexturesWithPendingWork();
+        for (uint32_t textureId : m_texturesWithPendingWork)
+        {
+            TiledTextureState& tiledTextureState = m_tiledTextures[textureId];
+            tiledTextureState.hasPendingWork = false;
+
+            // A tile can be unmapped and mapped again in the same frame, unbinds come first
+            if (!tiledTextureState.tilesToUnmap.empty())
+            {
+                GetTileRangesToUnmap(textureId, m_tileRanges);
+                for (auto& tileRange : m_tileRanges)
+                    tileBindings.push_back(TileBinding{textureId, tileRange.tileIndex, tileRange.tilesNum, tileRange.coord.x, tileRange.coord.y, tileRange.coord.mipLevel, TileBindingType_Unbind, 0, 0, UINT32_MAX});
+            }
+
+            if (!tiledTextureState.tilesToMap.empty())
+            {
+                GetTileRangesToMap(textureId, m_tileRanges);
+                for (auto& tileRange : m_tileRanges)
+                    tileBindings.push_back(TileBinding{textureId, tileRange.tileIndex, tileRange.tilesNum, tileRange.coord.x, tileRange.coord.y, tileRange.coord.mipLevel, TileBindingType_Bind, 0, tileRange.allocation.heapId, tileRange.allocation.heapTileIndex});
+            }
+        }
+        m_texturesWithPendingWork.clear();
+
+        return tileBindings;
+    }
+
+    void TiledTextureManagerImpl::UpdateTilesMapping(const std::vector<TileBinding>& tileBindings)
+    {
+        for (auto& tileBinding : tileBindings)
+        {
+            if (tileBinding.type != TileBindingType_Bind)
+                continue;
+
+            TiledTextureState& tiledTextureState = m_tiledTextures[tileBinding.textureId];
+            for (uint32_t i = 0; i < tileBinding.tilesNum; ++i)
+            {
+                // Bindings recorded before the tile was moved or allocated again don't map its current allocation
+                uint32_t tileIndex = tileBinding.tileIndex + i;
+                if (tileIndex >= (uint32_t)tiledTextureState.tileAllocations.size())
+                    break;
+
+                const TileAllocation& tileAllocation = tiledTextureState.tileAllocations[tileIndex];
+                if (tileAllocation.heapId != tileBinding.heapId || tileAllocation.heapTileIndex != tileBinding.heapTileIndex + i)
+                    continue;
+
+                if (tiledTextureState.tileStates[tileIndex] == TileState_Allocated)
+                    TransitionTile(tileBinding.textureId, tileIndex, TileState_Mapped);
+            }
+        }
+    }
+
+    // Drops the unmaps of tiles which were freed and allocated again since the lists were last handed out, mapping the new allocation replaces the old mapping
+    void TiledTextureManagerImpl::ReconcilePendingTiles(TiledTextureState& tiledTextureState)
+    {
+        if (tiledTextureState.tilesToMap.empty() || tiledTextureState.tilesToUnmap.empty())
+            return;
+
+        BitArray& tilesToMapBits = m_pendingTileBits;
+        tilesToMapBits.Init((uint32_t)tiledTextureState.tileStates.size());
+        tilesToMapBits.Clear();
+        for (uint32_t tileIndex : tiledTextureState.tilesToMap)
+            tilesToMapBits.SetBit(tileIndex);
+
+        auto& tilesToUnmap = tiledTextureState.tilesToUnmap;
+        tilesToUnmap.erase(std::remove_if(tilesToUnmap.begin(), tilesToUnmap.end(), [&](uint32_t tileIndex) { return tilesToMapBits.GetBit(tileIndex); }), tilesToUnmap.end());
+    }
+
+    // Sorts the tile indices and merges tiles which follow each other in the same row of a mip level, and in the same heap when useAllocations is set
+    void TiledTextureManagerImpl::BuildTileRanges(const TiledTextureState& tiledTextureState, std::vector<uint32_t>& tileIndices, bool useAllocations, std::vector<TileRange>& tileRanges) const
+    {
+        const TiledTextureSharedDesc& desc = m_tiledTextureSharedDescs[tiledTextureState.descIndex];
+
+        tileRanges.clear();
+        std::sort(tileIndices.begin(), tileIndices.end());
+        for (uint32_t tileIndex : tileIndices)
+        {
+            const TileCoord& tileCoord = desc.tileIndexToTileCoord[tileIndex];
+            TileAllocation tileAllocation = useAllocations ? tiledTextureState.tileAllocations[tileIndex] : TileAllocation();
+
+            if (!tileRanges.empty())
+            {
+                TileRange& tileRange = tileRanges.back();
+                bool isAdjacent = tileIndex == tileRange.tileIndex + tileRange.tilesNum && tileCoord.mipLevel == tileRange.coord.mipLevel && tileCoord.y == tileRange.coord.y;
+                bool isConsecutive = !useAllocations || (tileAllocation.IsValid() && tileRange.allocation.IsValid() &&
+                    tileAllocation.heapId == tileRange.allocation.heapId && tileAllocation.heapTileIndex == tileRange.allocation.heapTileIndex + tileRange.tilesNum);
+                if (isAdjacent && isConsecutive)
+                {
+                    tileRange.tilesNum++;
+                    continue;
+                }
+            }
+
+            tileRanges.push_back(TileRange{tileIndex, 1, tileCoord, tileAllocation});
+        }
+    }
+
     void TiledTextureManagerImpl::WriteMinMipData(uint32_t textureId, uint8_t* data)
     {
         TiledTextureState& tiledTextureState = m_tiledTextures[textureId];
@@ -329,17 +1093,68 @@ namespace rtxts
 
     void TiledTextureManagerImpl::DefragmentTiles(uint32_t numTiles)
     {
-        for (uint32_t i = 0; i < numTiles; i++)
+        auto& heapIds = m_moveHeapIds;
+        auto& tiles = m_moveTiles;
+        heapIds.clear();
+        tiles.clear();
+        m_tileAllocator->SelectHeapsToRelease(m_ownerId, UINT32_MAX, numTiles, heapIds, tiles);
+
+        for (auto& textureAndTile : tiles)
         {
-            TextureAndTile tileAllocation = m_tileAllocator->GetFragmentedTextureTile((TiledTextureManager*)this);
-            if (!tileAllocation.textureId)
-                break;
+            // Tiles sharing the heap tile move with it
+            SharedTileState* pSharedTile = FindSharedTile(textureAndTile.textureId, textureAndTile.tileIndex);
+            auto& movedTiles = m_sharedTilesScratch;
+            movedTiles.assign(1, textureAndTile);
+            if (pSharedTile)
+                movedTiles = pSharedTile->tiles;
 
             // Free tile from its current allocation
-            TransitionTile(tileAllocation.textureId, tileAllocation.tileIndex, TileState_Free);
+            for (auto& movedTile : movedTiles)
+                TransitionTile(movedTile.textureId, movedTile.tileIndex, TileState_Free);
 
             // Allocate tile again
-            TransitionTile(tileAllocation.textureId, tileAllocation.tileIndex, TileState_Requested);
+            for (auto& movedTile : movedTiles)
+                TransitionTile(movedTile.textureId, movedTile.tileIndex, TileState_Requested);
+        }
+    }
+
+    void TiledTextureManagerImpl::DefragmentTiles(uint32_t numTiles, std::vector<TileMove>& tileMoves)
+    {
+        PlanDefragmentation(UINT32_MAX, numTiles, tileMoves);
+    }
+
+    void TiledTextureManagerImpl::PlanDefragmentation(uint32_t maxHeapsNum, uint32_t maxMovesNum, std::vector<TileMove>& tileMoves)
+    {
+        tileMoves.clear();
+
+        auto& heapIds = m_moveHeapIds;
+        auto& tiles = m_moveTiles;
+        heapIds.clear();
+        tiles.clear();
+        m_tileAllocator->SelectHeapsToRelease(m_ownerId, maxHeapsNum, maxMovesNum, heapIds, tiles);
+        if (tiles.empty())
+            return;
+
+        auto& lifetimeClasses = m_moveLifetimeClasses;
+        lifetimeClasses.resize(tiles.size());
+        for (size_t i = 0; i < tiles.size(); ++i)
+        {
+            const TiledTextureState& tiledTextureState = m_tiledTextures[tiles[i].textureId];
+            lifetimeClasses[i] = GetTileLifetimeClass(m_tiledTextureSharedDescs[tiledTextureState.descIndex], tiles[i].tileIndex);
+        }
+
+        // Reserve destination slots, tiles keep their current allocation until the moves are completed
+        auto& dstAllocations = m_moveDstAllocations;
+        m_tileAllocator->AllocateMoveDestinations(m_ownerId, heapIds, tiles, lifetimeClasses, dstAllocations);
+
+        for (size_t i = 0; i < tiles.size(); ++i)
+        {
+            if (!dstAllocations[i].IsValid())
+                continue;
+
+            const TileAllocation& srcAllocation = m_tiledTextures[tiles[i].textureId].tileAllocations[tiles[i].tileIndex];
+            m_pendingTileMoves.insert(tiles[i], dstAllocations[i]);
+            tileMoves.push_back(TileMove{tiles[i].textureId, tiles[i].tileIndex, srcAllocation, dstAllocations[i]});
         }
     }
 
@@ -359,30 +1174,122 @@ namespace rtxts
     {
         const TiledTextureState& tiledTextureState = m_tiledTextures[textureId];
 
-        return tiledTextureState.tileAllocations;
+        return tiledTextureState.tileAllocations;
+    }
+
+    TextureDesc TiledTextureManagerImpl::GetTextureDesc(uint32_t textureId, TextureTypes textureType) const
+    {
+        const TiledTextureState& tiledTextureState = m_tiledTextures[textureId];
+        const TiledTextureSharedDesc& desc = m_tiledTextureSharedDescs[tiledTextureState.descIndex];
+
+        TextureDesc textureDesc = {};
+        switch (textureType)
+        {
+        case eFeedbackTexture:
+            textureDesc.textureOrMipRegionWidth = desc.tileWidth / desc.feedbackGranularityX;
+            textureDesc.textureOrMipRegionHeight = desc.tileHeight / desc.feedbackGranularityY;
+            textureDesc.mipLevelsNum = desc.regularMipLevelsNum + desc.packedMipLevelsNum;
+            break;
+        case eMinMipTexture:
+            textureDesc.textureOrMipRegionWidth = desc.regularTilesNum ? desc.mipLevelTilingDescs[0].tilesX : 1;
+            textureDesc.textureOrMipRegionHeight = desc.regularTilesNum ? desc.mipLevelTilingDescs[0].tilesY : 1;
+            textureDesc.mipLevelsNum = 1;
+            break;
+        }
+
+        return textureDesc;
+    }
+
+    void TiledTextureManagerImpl::SetTileContentHash(uint32_t textureId, uint32_t tileIndex, uint64_t contentHash)
+    {
+        TiledTextureState& tiledTextureState = m_tiledTextures[textureId];
+        if (tiledTextureState.contentHashes.empty())
+        {
+            if (!contentHash)
+                return;
+            tiledTextureState.contentHashes.resize(tiledTextureState.tileStates.size(), 0);
+        }
+
+        if (tiledTextureState.contentHashes[tileIndex] == contentHash)
+            return;
+
+        // The tile gets the heap tile of its new content when it is allocated again
+        if (tiledTextureState.tileAllocations[tileIndex].IsValid())
+            ReleaseTile(TextureAndTile{textureId, tileIndex});
+
+        tiledTextureState.contentHashes[tileIndex] = contentHash;
+    }
+
+    void TiledTextureManagerImpl::SetConstantTile(uint32_t constantTileId, const TileAllocation& tileAllocation)
+    {
+        if (constantTileId >= m_constantTiles.size())
+            m_constantTiles.resize(constantTileId + 1);
+        m_constantTiles[constantTileId] = tileAllocation;
+
+        // Tiles using the constant tile are mapped to its new location
+        for (uint32_t textureId = 0; textureId < (uint32_t)m_tiledTextures.size(); ++textureId)
+        {
+            TiledTextureState& tiledTextureState = m_tiledTextures[textureId];
+            if (!tiledTextureState.constantTilesNum)
+                continue;
+
+            for (uint32_t tileIndex = 0; tileIndex < (uint32_t)tiledTextureState.constantTileIds.size(); ++tileIndex)
+            {
+                if (tiledTextureState.constantTileIds[tileIndex] != constantTileId || !tiledTextureState.tileAllocations[tileIndex].IsValid())
+                    continue;
+
+                tiledTextureState.tileAllocations[tileIndex] = tileAllocation;
+                auto& tilesToMap = tiledTextureState.tilesToMap;
+                if (std::find(tilesToMap.begin(), tilesToMap.end(), tileIndex) == tilesToMap.end())
+                    tilesToMap.push_back(tileIndex);
+                MarkPendingWork(textureId);
+            }
+        }
+    }
+
+    void TiledTextureManagerImpl::SetTileConstant(uint32_t textureId, uint32_t tileIndex, uint32_t constantTileId)
+    {
+        TiledTextureState& tiledTextureState = m_tiledTextures[textureId];
+        const TiledTextureSharedDesc& desc = m_tiledTextureSharedDescs[tiledTextureState.descIndex];
+        if (tileIndex >= desc.regularTilesNum || (constantTileId != UINT32_MAX && constantTileId >= m_constantTiles.size()))
+            return;
+
+        if (tiledTextureState.constantTileIds.empty())
+        {
+            if (constantTileId == UINT32_MAX)
+                return;
+            tiledTextureState.constantTileIds.resize(desc.regularTilesNum, UINT32_MAX);
+        }
+
+        if (tiledTextureState.constantTileIds[tileIndex] == constantTileId)
+            return;
+
+        // The tile gives up its current allocation and is requested again with the new flag if it is still needed
+        bool isRequested = tiledTextureState.requestedBits.GetBitsNum() && tiledTextureState.requestedBits.GetBit(tileIndex);
+        bool isReleased = tiledTextureState.tileAllocations[tileIndex].IsValid();
+        if (isReleased)
+        {
+            auto& tilesToMap = tiledTextureState.tilesToMap;
+            if (tiledTextureState.tileStates[tileIndex] == TileState_Allocated)
+                tilesToMap.erase(std::remove(tilesToMap.begin(), tilesToMap.end(), tileIndex), tilesToMap.end());
+
+            TransitionTile(textureId, tileIndex, TileState_Free);
+        }
+
+        tiledTextureState.constantTileIds[tileIndex] = constantTileId;
+
+        if (isReleased && isRequested)
+            TransitionTile(textureId, tileIndex, TileState_Requested);
     }
 
-    TextureDesc TiledTextureManagerImpl::GetTextureDesc(uint32_t textureId, TextureTypes textureType) const
+    bool TiledTextureManagerImpl::IsSharedTile(uint32_t textureId, uint32_t tileIndex) const
     {
         const TiledTextureState& tiledTextureState = m_tiledTextures[textureId];
-        const TiledTextureSharedDesc& desc = m_tiledTextureSharedDescs[tiledTextureState.descIndex];
-
-        TextureDesc textureDesc = {};
-        switch (textureType)
-        {
-        case eFeedbackTexture:
-            textureDesc.textureOrMipRegionWidth = desc.tileWidth / desc.feedbackGranularityX;
-            textureDesc.textureOrMipRegionHeight = desc.tileHeight / desc.feedbackGranularityY;
-            textureDesc.mipLevelsNum = desc.regularMipLevelsNum + desc.packedMipLevelsNum;
-            break;
-        case eMinMipTexture:
-            textureDesc.textureOrMipRegionWidth = desc.regularTilesNum ? desc.mipLevelTilingDescs[0].tilesX : 1;
-            textureDesc.textureOrMipRegionHeight = desc.regularTilesNum ? desc.mipLevelTilingDescs[0].tilesY : 1;
-            textureDesc.mipLevelsNum = 1;
-            break;
-        }
+        if (tiledTextureState.contentHashes.empty() || !tiledTextureState.tileAllocations[tileIndex].IsValid())
+            return false;
 
-        return textureDesc;
+        auto it = m_sharedTiles.find(tiledTextureState.contentHashes[tileIndex]);
+        return it != m_sharedTiles.end() && !(it->second.tiles.front() == TextureAndTile{textureId, tileIndex});
     }
 
     bool TiledTextureManagerImpl::IsMovableTile(uint32_t textureId, uint32_t tileIndex) const
@@ -390,6 +1297,9 @@ namespace rtxts
         const TiledTextureState& tiledTextureState = m_tiledTextures[textureId];
         const TiledTextureSharedDesc& desc = m_tiledTextureSharedDescs[tiledTextureState.descIndex];
 
+        if (m_pendingTileMoves.find(TextureAndTile{textureId, tileIndex}) || IsConstantTile(tiledTextureState, tileIndex))
+            return false;
+
         return (tileIndex < desc.regularTilesNum) && (tiledTextureState.tileStates[tileIndex] == TileState_Mapped || tiledTextureState.tileStates[tileIndex] == TileState_Standby);
     }
 
@@ -400,9 +1310,30 @@ namespace rtxts
         if (m_tileAllocator)
         {
             statistics.totalTilesNum = m_totalTilesNum;
-            statistics.allocatedTilesNum = m_tileAllocator->GetAllocatedTilesNum();
+            statistics.allocatedTilesNum = m_tileAllocator->GetAllocatedTilesNum(m_ownerId);
             statistics.heapFreeTilesNum = m_tileAllocator->GetFreeTilesNum();
             statistics.standbyTilesNum = (uint32_t)m_standbyQueue.size();
+            statistics.sharedTilesNum = m_sharedTilesNum;
+        }
+
+        return statistics;
+    }
+
+    void TiledTextureManagerImpl::GetExtendedStatistics(ExtendedStatistics& statistics) const
+    {
+        m_tileAllocator->GetExtendedStatistics(statistics);
+    }
+
+    MemoryPoolStatistics TiledTextureManagerImpl::GetMemoryPoolStatistics(uint32_t poolId) const
+    {
+        MemoryPoolStatistics statistics = {};
+
+        if (poolId < m_memoryPools.size())
+        {
+            const MemoryPoolState& memoryPool = m_memoryPools[poolId];
+            statistics.allocatedTilesNum = memoryPool.allocatedTilesNum;
+            statistics.standbyTilesNum = (uint32_t)memoryPool.standbyQueue.size();
+            statistics.borrowedTilesNum = memoryPool.allocatedTilesNum - std::min(memoryPool.allocatedTilesNum, memoryPool.desc.guaranteedTilesNum);
         }
 
         return statistics;
@@ -410,7 +1341,8 @@ namespace rtxts
 
     void TiledTextureManagerImpl::InitTiledTexture(uint32_t textureId, const TiledTextureDesc& tiledTextureDesc)
     {
-        TiledTextureSharedDesc desc = {};
+        // The descriptor is only copied when no existing one matches
+        TiledTextureSharedDesc& desc = m_newSharedDesc;
         desc.regularTilesNum = 0;
         desc.mipLevelTilingDescs.resize(tiledTextureDesc.regularMipLevelsNum);
         for (uint32_t i = 0; i < tiledTextureDesc.regularMipLevelsNum; ++i)
@@ -422,8 +1354,7 @@ namespace rtxts
             desc.regularTilesNum += tiledTextureDesc.tiledLevelDescs[i].widthInTiles * tiledTextureDesc.tiledLevelDescs[i].heightInTiles;
         }
 
-        if (tiledTextureDesc.packedMipLevelsNum)
-            desc.packedTilesNum = tiledTextureDesc.packedTilesNum;
+        desc.packedTilesNum = tiledTextureDesc.packedMipLevelsNum ? tiledTextureDesc.packedTilesNum : 0;
 
         desc.regularMipLevelsNum = tiledTextureDesc.regularMipLevelsNum;
         desc.packedMipLevelsNum = tiledTextureDesc.packedMipLevelsNum;
@@ -456,11 +1387,25 @@ namespace rtxts
         tiledTextureState.lastRequestedTime.resize(tilesNum);
         tiledTextureState.tileAllocations.resize(tilesNum);
         tiledTextureState.requestedTilesNum = desc.packedTilesNum;
+        m_requestedTilesNum += desc.packedTilesNum;
+        tiledTextureState.poolId = tiledTextureDesc.poolId;
+        GetMemoryPool(tiledTextureDesc.poolId);
 
         tiledTextureState.tileStates.resize(tilesNum);
         for (uint32_t i = 0; i < tilesNum; ++i)
             tiledTextureState.tileStates[i] = TileState_Free;
 
+        // Pending lists of bounded managers never grow during a frame
+        if (m_tiledTextureManagerDesc.maxTilesNum)
+        {
+            tiledTextureState.tilesToMap.reserve(tilesNum);
+            tiledTextureState.tilesToUnmap.reserve(tilesNum);
+            tiledTextureState.tilesToMapFront.reserve(tilesNum);
+            tiledTextureState.tilesToUnmapFront.reserve(tilesNum);
+            tiledTextureState.standbyQueue.Reserve(desc.regularTilesNum);
+            tiledTextureState.requestedBits.Reserve(tilesNum);
+        }
+
         // Find an already existing shared descriptor which makes this tiled texture
         // TODO: This is a linear search and can be optimized
         uint32_t sharedDescsNum = (uint32_t)m_tiledTextureSharedDescs.size();
@@ -529,20 +1474,50 @@ namespace rtxts
             TransitionTile(textureId, desc.regularTilesNum + i, TileState_Requested);
     }
 
-    void TiledTextureManagerImpl::UpdateTiledTexture(uint32_t textureId, BitArray requestedBits, uint32_t firstTileIndex, float timestamp, float timeout)
+    void TiledTextureManagerImpl::ResetTiledTextureState(TiledTextureState& tiledTextureState)
+    {
+        TiledTextureState resetState;
+
+        // Bounded managers keep the per-tile storage for the next texture using the slot
+        if (m_tiledTextureManagerDesc.maxTilesNum)
+        {
+            resetState.lastRequestedTime.swap(tiledTextureState.lastRequestedTime);
+            resetState.tileAllocations.swap(tiledTextureState.tileAllocations);
+            resetState.tilesToMap.swap(tiledTextureState.tilesToMap);
+            resetState.tilesToUnmap.swap(tiledTextureState.tilesToUnmap);
+            resetState.tilesToMapFront.swap(tiledTextureState.tilesToMapFront);
+            resetState.tilesToUnmapFront.swap(tiledTextureState.tilesToUnmapFront);
+            resetState.tileStates.swap(tiledTextureState.tileStates);
+            resetState.standbyQueue = std::move(tiledTextureState.standbyQueue);
+
+            resetState.lastRequestedTime.clear();
+            resetState.tileAllocations.clear();
+            resetState.tilesToMap.clear();
+            resetState.tilesToUnmap.clear();
+            resetState.tilesToMapFront.clear();
+            resetState.tilesToUnmapFront.clear();
+            resetState.tileStates.clear();
+        }
+
+        tiledTextureState = std::move(resetState);
+    }
+
+    void TiledTextureManagerImpl::UpdateTiledTexture(uint32_t textureId, const BitArray& requestedBits, uint32_t firstTileIndex, float timestamp, float timeout)
     {
         TiledTextureState& tiledTextureState = m_tiledTextures[textureId];
         const TiledTextureSharedDesc& desc = m_tiledTextureSharedDescs[tiledTextureState.descIndex];
 
         // Save requested bites for use in follower textures
         tiledTextureState.requestedBits = requestedBits;
+        m_latestTimeStamp = std::max(m_latestTimeStamp, timestamp);
 
+        m_requestedTilesNum -= tiledTextureState.requestedTilesNum - desc.packedTilesNum;
         tiledTextureState.requestedTilesNum = desc.packedTilesNum;
         if (desc.regularMipLevelsNum == 0)
             return;
 
         bool requestedUnpackedTiles = firstTileIndex != UINT32_MAX;
-        if (requestedUnpackedTiles || tiledTextureState.allocatedUnpackedTilesNum)
+        if (requestedUnpackedTiles || tiledTextureState.allocatedUnpackedTilesNum || tiledTextureState.constantTilesNum)
         {
             for (uint32_t tileIndex = 0; tileIndex < desc.regularTilesNum; ++tileIndex)
             {
@@ -550,7 +1525,12 @@ namespace rtxts
                 {
                     // Tile is being requested
                     tiledTextureState.lastRequestedTime[tileIndex] = timestamp;
-                    tiledTextureState.requestedTilesNum++;
+                    if (!IsConstantTile(tiledTextureState, tileIndex))
+                    {
+                        // Constant tiles don't need heap memory
+                        tiledTextureState.requestedTilesNum++;
+                        m_requestedTilesNum++;
+                    }
 
                     if (tiledTextureState.tileStates[tileIndex] == TileState_Standby)
                     {
@@ -592,6 +1572,22 @@ namespace rtxts
         return start + offset;
     }
 
+    TileLifetimeClass TiledTextureManagerImpl::GetTileLifetimeClass(const TiledTextureSharedDesc& tiledTextureDesc, uint32_t tileIndex) const
+    {
+        if (!m_tiledTextureManagerDesc.segregateTileLifetimes)
+            return TileLifetimeClass_Short;
+
+        // Packed tiles are allocated with the texture and coarse mip levels are requested whenever any part of the texture is visible
+        if (tileIndex >= tiledTextureDesc.regularTilesNum)
+            return TileLifetimeClass_Long;
+
+        uint32_t mipLevel = tiledTextureDesc.tileIndexToTileCoord[tileIndex].mipLevel;
+        if (mipLevel + m_tiledTextureManagerDesc.longLivedMipLevelsNum >= tiledTextureDesc.regularMipLevelsNum)
+            return TileLifetimeClass_Long;
+
+        return TileLifetimeClass_Short;
+    }
+
     bool TiledTextureManagerImpl::TransitionTile(uint32_t textureId, uint32_t tileIndex, TileState newState)
     {
         TiledTextureState& tiledTextureState = m_tiledTextures[textureId];
@@ -599,6 +1595,19 @@ namespace rtxts
 
         auto& tileState = tiledTextureState.tileStates[tileIndex];
 
+        // Constant tiles skip the requested queue and never enter standby
+        bool isConstantTile = IsConstantTile(tiledTextureState, tileIndex);
+        if (isConstantTile)
+        {
+            if (newState == TileState_Requested)
+                newState = TileState_Allocated;
+            else if (newState == TileState_Standby)
+                newState = TileState_Free;
+
+            if (newState == tileState)
+                return true;
+        }
+
 #if _DEBUG
         // Cannot change to the same state
         assert(newState != tileState);
@@ -606,13 +1615,13 @@ namespace rtxts
         switch(tileState)
         {
             case TileState_Free:
-                assert(newState == TileState_Requested || newState == TileState_Standby);
+                assert(newState == TileState_Requested || newState == TileState_Standby || (isConstantTile && newState == TileState_Allocated));
                 break;
             case TileState_Requested:
                 assert(newState == TileState_Allocated || newState == TileState_Standby);
                 break;
             case TileState_Allocated:
-                assert(newState == TileState_Mapped || newState == TileState_Standby);
+                assert(newState == TileState_Mapped || newState == TileState_Standby || newState == TileState_Free);
                 break;
             case TileState_Mapped:
                 assert(newState == TileState_Free || newState == TileState_Standby);
@@ -640,7 +1649,17 @@ namespace rtxts
         {
             // Tile is in standby queue, remove from standby queue
             m_standbyQueue.erase(TextureAndTile{textureId, tileIndex});
+            GetMemoryPool(tiledTextureState.poolId).standbyQueue.erase(TextureAndTile{textureId, tileIndex});
+            if (tileIndex < desc.regularTilesNum)
+            {
+                tiledTextureState.standbyUnpackedTilesNum--;
+                tiledTextureState.standbyQueue.erase(tileIndex);
+                if (tiledTextureState.categoryId)
+                    GetTileCategory(tiledTextureState.categoryId).standbyQueue.erase(TextureAndTile{textureId, tileIndex});
+            }
         }
+        else if (tileState == TileState_Mapped && tileIndex < desc.regularTilesNum)
+            GetMemoryPool(tiledTextureState.poolId).mappedQueue.erase(TextureAndTile{textureId, tileIndex});
 #if _DEBUG
         assert(!m_standbyQueue.contains(TextureAndTile{textureId, tileIndex}));
 #endif
@@ -650,12 +1669,55 @@ namespace rtxts
         {
             case TileState_Free:
             {
-                m_tileAllocator->FreeTile(tiledTextureState.tileAllocations[tileIndex]);
+                // An allocated tile whose mapping was not handed out yet was never mapped, the pending map is dropped instead of adding an unmap
+                auto& tilesToMap = tiledTextureState.tilesToMap;
+                auto tileToMapIt = std::find(tilesToMap.begin(), tilesToMap.end(), tileIndex);
+                bool needsUnmap = tileToMapIt == tilesToMap.end() || tileState != TileState_Allocated;
+                if (tileToMapIt != tilesToMap.end())
+                    tilesToMap.erase(tileToMapIt);
+
+                if (isConstantTile)
+                {
+                    tiledTextureState.tileAllocations[tileIndex] = {};
+                    tiledTextureState.constantTilesNum--;
+                    if (needsUnmap)
+                    {
+                        tiledTextureState.tilesToUnmap.push_back(tileIndex);
+                        MarkPendingWork(textureId);
+                    }
+                    m_activeTilesNum--;
+                    break;
+                }
+
+                if (m_pendingTileMoves.size())
+                    CancelTileMove(textureId, tileIndex);
+
+                // Tiles in a reserved heap were never handed out for mapping
+                bool isReservedHeapTile = m_reservedHeapTiles.size() && m_reservedHeapTiles.contains(TextureAndTile{textureId, tileIndex});
+                assert(!tiledTextureState.tileAllocations[tileIndex].IsValid() || isReservedHeapTile == m_tileAllocator->IsReservedHeap(tiledTextureState.tileAllocations[tileIndex].heapId));
+                if (isReservedHeapTile)
+                    m_reservedHeapTiles.erase(TextureAndTile{textureId, tileIndex});
+
+                if (tiledTextureState.tileAllocations[tileIndex].IsValid() && FindSharedTile(textureId, tileIndex))
+                    FreeSharedTile(textureId, tileIndex);
+                else
+                {
+                    m_tileAllocator->FreeTile(tiledTextureState.tileAllocations[tileIndex]);
+                    GetMemoryPool(tiledTextureState.poolId).allocatedTilesNum--;
+                }
                 tiledTextureState.tileAllocations[tileIndex] = {};
                 m_activeTilesNum--;
-                tiledTextureState.tilesToUnmap.push_back(tileIndex);
+                if (!isReservedHeapTile && needsUnmap)
+                {
+                    tiledTextureState.tilesToUnmap.push_back(tileIndex);
+                    MarkPendingWork(textureId);
+                }
                 if (tileIndex < desc.regularTilesNum)
+                {
                     tiledTextureState.allocatedUnpackedTilesNum--;
+                    if (tiledTextureState.categoryId)
+                        GetTileCategory(tiledTextureState.categoryId).allocatedTilesNum--;
+                }
                 break;
             }
 
@@ -669,41 +1731,475 @@ namespace rtxts
 
             case TileState_Allocated:
             {
-                if (m_tileAllocator->GetFreeTilesNum() == 0 && m_standbyQueue.size() > 0)
+                if (isConstantTile)
                 {
-                    // Remove the oldest tile from the standby queue
-                    TextureAndTile textureAndTile = m_standbyQueue.front();
-                    TransitionTile(textureAndTile.textureId, textureAndTile.tileIndex, TileState_Free);
+                    // The prefilled constant tile of the application is used instead of a heap tile
+                    tiledTextureState.tileAllocations[tileIndex] = m_constantTiles[tiledTextureState.constantTileIds[tileIndex]];
+                    tiledTextureState.constantTilesNum++;
+                    tiledTextureState.tilesToMap.push_back(tileIndex);
+                    MarkPendingWork(textureId);
+                    if (tileState == TileState_Free)
+                        m_activeTilesNum++;
+                    break;
                 }
-                TileAllocation alloc = m_tileAllocator->AllocateTile(textureId, tileIndex);
-                if (!alloc.IsValid())
-                {
-                    // Failed to allocate this tile
+
+                if (!EnforceActiveQuota(textureId, tileIndex))
                     return false;
+
+                TileAllocation alloc;
+                SharedTileState* pSharedTile = FindSharedTile(textureId, tileIndex);
+                if (pSharedTile)
+                {
+                    // The content is already in a heap tile
+                    alloc = pSharedTile->allocation;
+                    pSharedTile->tiles.push_back(TextureAndTile{textureId, tileIndex});
+                    m_sharedTilesNum++;
+                }
+                else
+                {
+                    // Evicting standby tiles which share their heap tile with active tiles frees no memory, keep going until a heap tile is freed
+                    uint32_t allocatedTilesNum = m_tileAllocator->GetAllocatedTilesNum();
+                    if (m_tileAllocator->GetFreeTilesNum() == 0 || allocatedTilesNum >= m_tileAllocator->GetBudgetTilesNum())
+                    {
+                        while (EvictStandbyTile(tiledTextureState.poolId) && m_tileAllocator->GetAllocatedTilesNum() == allocatedTilesNum)
+                            ;
+
+                        // A pool within its guarantee takes back a mapped tile borrowed by another pool when there is no standby tile left to evict
+                        if (m_tileAllocator->GetAllocatedTilesNum() == allocatedTilesNum && IsPoolWithinGuarantee(tiledTextureState.poolId))
+                            EvictMappedTiles(1, true);
+                    }
+
+                    if (m_tileAllocator->GetAllocatedTilesNum() >= m_tileAllocator->GetBudgetTilesNum())
+                        return false;
+
+                    HeapHandle preferredHeap = InvalidHeapHandle;
+                    uint32_t preferredHeapTileIndex = 0;
+                    if (m_tiledTextureManagerDesc.textureAffinityPlacement)
+                    {
+                        // Place the tile right after its left neighbor in the same mip level, or after the last tile allocated for the texture
+                        const TileAllocation* pNeighborAllocation = tileIndex > 0 ? &tiledTextureState.tileAllocations[tileIndex - 1] : nullptr;
+                        if (pNeighborAllocation && pNeighborAllocation->IsValid() && desc.tileIndexToTileCoord[tileIndex - 1].mipLevel == desc.tileIndexToTileCoord[tileIndex].mipLevel)
+                        {
+                            preferredHeap = m_tileAllocator->GetHeapHandle(pNeighborAllocation->heapId);
+                            preferredHeapTileIndex = pNeighborAllocation->heapTileIndex + 1;
+                        }
+                        else
+                        {
+                            preferredHeap = tiledTextureState.affinityHeap;
+                            preferredHeapTileIndex = tiledTextureState.affinityHeapTileIndex;
+                        }
+                    }
+
+                    alloc = m_tileAllocator->AllocateTile(m_ownerId, textureId, tileIndex, GetTileLifetimeClass(desc, tileIndex), preferredHeap, preferredHeapTileIndex, true);
+                    if (!alloc.IsValid())
+                    {
+                        // Failed to allocate this tile
+                        return false;
+                    }
+
+                    if (m_tiledTextureManagerDesc.textureAffinityPlacement)
+                    {
+                        tiledTextureState.affinityHeap = m_tileAllocator->GetHeapHandle(alloc.heapId);
+                        tiledTextureState.affinityHeapTileIndex = alloc.heapTileIndex + 1;
+                    }
+
+                    uint64_t contentHash = tiledTextureState.contentHashes.empty() ? 0 : tiledTextureState.contentHashes[tileIndex];
+                    if (contentHash)
+                        m_sharedTiles[contentHash] = SharedTileState{alloc, {TextureAndTile{textureId, tileIndex}}};
+                    GetMemoryPool(tiledTextureState.poolId).allocatedTilesNum++;
                 }
                 tiledTextureState.tileAllocations[tileIndex] = alloc;
-                tiledTextureState.tilesToMap.push_back(tileIndex);
+
+                // Tiles in a reserved heap are mapped once the heap is committed
+                if (m_tileAllocator->IsReservedHeap(alloc.heapId))
+                    m_reservedHeapTiles.push_back(TextureAndTile{textureId, tileIndex});
+                else
+                {
+                    tiledTextureState.tilesToMap.push_back(tileIndex);
+                    MarkPendingWork(textureId);
+                }
                 if (tileIndex < desc.regularTilesNum)
+                {
                     tiledTextureState.allocatedUnpackedTilesNum++;
+                    if (tiledTextureState.categoryId)
+                        GetTileCategory(tiledTextureState.categoryId).allocatedTilesNum++;
+                }
                 break;
             }
             case TileState_Mapped:
             {
+                if (tileIndex < desc.regularTilesNum && !isConstantTile)
+                    GetMemoryPool(tiledTextureState.poolId).mappedQueue.push_back(TextureAndTile{textureId, tileIndex});
                 break;
             }
             case TileState_Standby:
             {
                 m_standbyQueue.push_back(TextureAndTile{textureId, tileIndex});
+                GetMemoryPool(tiledTextureState.poolId).standbyQueue.push_back(TextureAndTile{textureId, tileIndex});
+                if (tileIndex < desc.regularTilesNum)
+                {
+                    tiledTextureState.standbyUnpackedTilesNum++;
+                    tiledTextureState.standbyQueue.push_back(tileIndex);
+                    if (tiledTextureState.categoryId)
+                        GetTileCategory(tiledTextureState.categoryId).standbyQueue.push_back(TextureAndTile{textureId, tileIndex});
+                }
                 break;
             }
         }
 
         tileState = newState;
+
+        if (newState == TileState_Standby)
+            EnforceStandbyQuota(textureId);
+
+        return true;
+    }
+
+    bool TiledTextureManagerImpl::IsConstantTile(const TiledTextureState& tiledTextureState, uint32_t tileIndex) const
+    {
+        return tileIndex < tiledTextureState.constantTileIds.size() && tiledTextureState.constantTileIds[tileIndex] != UINT32_MAX;
+    }
+
+    void TiledTextureManagerImpl::CancelTileMove(uint32_t textureId, uint32_t tileIndex)
+    {
+        TileAllocation* pDstAllocation = m_pendingTileMoves.find(TextureAndTile{textureId, tileIndex});
+        if (!pDstAllocation)
+            return;
+
+        m_tileAllocator->FreeTile(*pDstAllocation);
+        m_pendingTileMoves.erase(TextureAndTile{textureId, tileIndex});
+    }
+
+    SharedTileState* TiledTextureManagerImpl::FindSharedTile(uint32_t textureId, uint32_t tileIndex)
+    {
+        const TiledTextureState& tiledTextureState = m_tiledTextures[textureId];
+        if (m_sharedTiles.empty() || tiledTextureState.contentHashes.empty() || !tiledTextureState.contentHashes[tileIndex])
+            return nullptr;
+
+        auto it = m_sharedTiles.find(tiledTextureState.contentHashes[tileIndex]);
+        return it != m_sharedTiles.end() ? &it->second : nullptr;
+    }
+
+    void TiledTextureManagerImpl::FreeSharedTile(uint32_t textureId, uint32_t tileIndex)
+    {
+        TiledTextureState& tiledTextureState = m_tiledTextures[textureId];
+        uint64_t contentHash = tiledTextureState.contentHashes[tileIndex];
+        SharedTileState& sharedTile = m_sharedTiles[contentHash];
+
+        // The tile may still be waiting to be remapped after a move of the heap tile
+        auto& tilesToMap = tiledTextureState.tilesToMap;
+        tilesToMap.erase(std::remove(tilesToMap.begin(), tilesToMap.end(), tileIndex), tilesToMap.end());
+
+        // The heap tile is accounted to the pool of its first tile
+        auto& tiles = sharedTile.tiles;
+        bool isOwner = tiles.front() == TextureAndTile{textureId, tileIndex};
+        tiles.erase(std::find(tiles.begin(), tiles.end(), TextureAndTile{textureId, tileIndex}));
+        if (isOwner)
+            GetMemoryPool(tiledTextureState.poolId).allocatedTilesNum--;
+        if (tiles.empty())
+        {
+            m_tileAllocator->FreeTile(sharedTile.allocation);
+            m_sharedTiles.erase(contentHash);
+            return;
+        }
+
+        // The heap tile stays allocated for the remaining tiles
+        m_sharedTilesNum--;
+        if (isOwner)
+        {
+            m_tileAllocator->SetTileOwner(sharedTile.allocation, tiles.front().textureId, tiles.front().tileIndex);
+            GetMemoryPool(m_tiledTextures[tiles.front().textureId].poolId).allocatedTilesNum++;
+        }
+    }
+
+    void TiledTextureManagerImpl::UpdateSharedTileAllocation(SharedTileState& sharedTile, const TileAllocation& tileAllocation)
+    {
+        sharedTile.allocation = tileAllocation;
+
+        // Only the first tile was moved, the others are remapped to the new heap tile
+        for (size_t i = 1; i < sharedTile.tiles.size(); ++i)
+        {
+            TiledTextureState& tiledTextureState = m_tiledTextures[sharedTile.tiles[i].textureId];
+            tiledTextureState.tileAllocations[sharedTile.tiles[i].tileIndex] = tileAllocation;
+
+            auto& tilesToMap = tiledTextureState.tilesToMap;
+            if (std::find(tilesToMap.begin(), tilesToMap.end(), sharedTile.tiles[i].tileIndex) == tilesToMap.end())
+                tilesToMap.push_back(sharedTile.tiles[i].tileIndex);
+            MarkPendingWork(sharedTile.tiles[i].textureId);
+        }
+    }
+
+    TileCategoryState& TiledTextureManagerImpl::GetTileCategory(uint32_t categoryId)
+    {
+        if (categoryId >= m_tileCategories.size())
+            m_tileCategories.resize(categoryId + 1);
+
+        return m_tileCategories[categoryId];
+    }
+
+    MemoryPoolState& TiledTextureManagerImpl::GetMemoryPool(uint32_t poolId)
+    {
+        if (poolId >= m_memoryPools.size())
+        {
+            // Pools of bounded managers are set up with storage for all tiles
+            uint32_t firstPoolId = (uint32_t)m_memoryPools.size();
+            m_memoryPools.resize(poolId + 1);
+            for (uint32_t memoryPoolId = firstPoolId; m_tiledTextureManagerDesc.maxTilesNum && memoryPoolId <= poolId; ++memoryPoolId)
+            {
+                m_memoryPools[memoryPoolId].standbyQueue.Reserve(m_tiledTextureManagerDesc.maxTilesNum);
+                m_memoryPools[memoryPoolId].mappedQueue.Reserve(m_tiledTextureManagerDesc.maxTilesNum);
+            }
+        }
+
+        return m_memoryPools[poolId];
+    }
+
+    bool TiledTextureManagerImpl::FindPoolStandbyTile(uint32_t poolId, bool ignoreGuarantees, TextureAndTile& evictTile, float& evictTileTime) const
+    {
+        // The least recently requested standby tile of the allocating pool or of a pool holding more than its guarantee,
+        // so borrowed tiles are reclaimed first and pools within their guarantee keep their standby tiles
+        bool isFound = false;
+        for (uint32_t memoryPoolId = 0; memoryPoolId < (uint32_t)m_memoryPools.size(); ++memoryPoolId)
+        {
+            const MemoryPoolState& memoryPool = m_memoryPools[memoryPoolId];
+            if (memoryPool.standbyQueue.size() == 0)
+                continue;
+
+            if (!ignoreGuarantees && memoryPoolId != poolId && memoryPool.allocatedTilesNum <= memoryPool.desc.guaranteedTilesNum)
+                continue;
+
+            const TextureAndTile& textureAndTile = memoryPool.standbyQueue.front();
+            float lastRequestedTime = m_tiledTextures[textureAndTile.textureId].lastRequestedTime[textureAndTile.tileIndex];
+            if (!isFound || lastRequestedTime < evictTileTime)
+            {
+                evictTile = textureAndTile;
+                evictTileTime = lastRequestedTime;
+                isFound = true;
+            }
+        }
+
+        return isFound;
+    }
+
+    bool TiledTextureManagerImpl::EvictStandbyTile(uint32_t poolId, bool ignoreGuarantees)
+    {
+        TiledTextureManagerImpl* pEvictManager = nullptr;
+        TextureAndTile evictTile = {};
+        float evictTileTime = 0.0f;
+        if (FindPoolStandbyTile(poolId, ignoreGuarantees, evictTile, evictTileTime))
+            pEvictManager = this;
+
+        // Managers sharing the heaps give up their least recently requested standby tiles as well, pools within their guarantee are kept
+        for (auto pOwner : m_tileAllocator->GetOwners())
+        {
+            if (!pOwner || pOwner == this)
+                continue;
+
+            TextureAndTile textureAndTile;
+            float lastRequestedTime;
+            TiledTextureManagerImpl* pManager = static_cast<TiledTextureManagerImpl*>(pOwner);
+            if (pManager->FindPoolStandbyTile(UINT32_MAX, ignoreGuarantees, textureAndTile, lastRequestedTime) && (!pEvictManager || lastRequestedTime < evictTileTime))
+            {
+                pEvictManager = pManager;
+                evictTile = textureAndTile;
+                evictTileTime = lastRequestedTime;
+            }
+        }
+
+        if (!pEvictManager)
+            return false;
+
+        SharedTileState* pSharedTile = pEvictManager->FindSharedTile(evictTile.textureId, evictTile.tileIndex);
+        auto& sharedTiles = pEvictManager->m_sharedTilesScratch;
+        sharedTiles.clear();
+        if (pSharedTile)
+            sharedTiles = pSharedTile->tiles;
+
+        if (!pEvictManager->TransitionTile(evictTile.textureId, evictTile.tileIndex, TileState_Free))
+            return false;
+
+        // The heap tile is only freed with the last tile sharing it, take along the other sharing tiles if they are all in standby
+        sharedTiles.erase(std::remove(sharedTiles.begin(), sharedTiles.end(), evictTile), sharedTiles.end());
+        bool isStandbyOnly = std::all_of(sharedTiles.begin(), sharedTiles.end(), [pEvictManager](const TextureAndTile& sharedTile)
+            {
+                return pEvictManager->m_tiledTextures[sharedTile.textureId].tileStates[sharedTile.tileIndex] == TileState_Standby;
+            });
+        if (isStandbyOnly)
+        {
+            for (auto& sharedTile : sharedTiles)
+                pEvictManager->TransitionTile(sharedTile.textureId, sharedTile.tileIndex, TileState_Free);
+        }
+
+        return true;
+    }
+
+    void TiledTextureManagerImpl::EvictMappedTiles(uint32_t tilesNum, bool borrowedTilesOnly)
+    {
+        for (; tilesNum > 0; --tilesNum)
+        {
+            // The earliest mapped tile of a pool, least recently requested first among the pools of all managers sharing the heaps.
+            // Packed tiles are required for sampling the texture and are never in the mapped queues
+            TiledTextureManagerImpl* pEvictManager = nullptr;
+            TextureAndTile evictTile = {};
+            float evictTileTime = 0.0f;
+            for (auto pOwner : m_tileAllocator->GetOwners())
+            {
+                if (!pOwner)
+                    continue;
+
+                TiledTextureManagerImpl* pManager = static_cast<TiledTextureManagerImpl*>(pOwner);
+                for (uint32_t memoryPoolId = 0; memoryPoolId < (uint32_t)pManager->m_memoryPools.size(); ++memoryPoolId)
+                {
+                    const MemoryPoolState& memoryPool = pManager->m_memoryPools[memoryPoolId];
+                    if (memoryPool.mappedQueue.size() == 0 || (borrowedTilesOnly && !pManager->IsPoolBorrowing(memoryPoolId)))
+                        continue;
+
+                    const TextureAndTile& textureAndTile = memoryPool.mappedQueue.front();
+                    float lastRequestedTime = pManager->m_tiledTextures[textureAndTile.textureId].lastRequestedTime[textureAndTile.tileIndex];
+                    if (!pEvictManager || lastRequestedTime < evictTileTime)
+                    {
+                        pEvictManager = pManager;
+                        evictTile = textureAndTile;
+                        evictTileTime = lastRequestedTime;
+                    }
+                }
+            }
+
+            if (!pEvictManager)
+                return;
+
+            // Tiles sharing the heap tile are evicted with it, otherwise no memory is freed
+            SharedTileState* pSharedTile = pEvictManager->FindSharedTile(evictTile.textureId, evictTile.tileIndex);
+            if (pSharedTile)
+            {
+                auto& sharedTiles = pEvictManager->m_sharedTilesScratch;
+                sharedTiles = pSharedTile->tiles;
+                for (auto& sharedTile : sharedTiles)
+                    pEvictManager->TransitionTile(sharedTile.textureId, sharedTile.tileIndex, TileState_Free);
+            }
+            else
+                pEvictManager->TransitionTile(evictTile.textureId, evictTile.tileIndex, TileState_Free);
+        }
+    }
+
+    bool TiledTextureManagerImpl::IsPoolBorrowing(uint32_t poolId) const
+    {
+        if (poolId >= m_memoryPools.size())
+            return false;
+
+        const MemoryPoolState& memoryPool = m_memoryPools[poolId];
+        return memoryPool.allocatedTilesNum > memoryPool.desc.guaranteedTilesNum;
+    }
+
+    bool TiledTextureManagerImpl::IsPoolWithinGuarantee(uint32_t poolId) const
+    {
+        if (poolId >= m_memoryPools.size())
+            return false;
+
+        const MemoryPoolState& memoryPool = m_memoryPools[poolId];
+        return memoryPool.allocatedTilesNum < memoryPool.desc.guaranteedTilesNum;
+    }
+
+    bool TiledTextureManagerImpl::HasPoolWithinGuarantee() const
+    {
+        for (uint32_t memoryPoolId = 0; memoryPoolId < (uint32_t)m_memoryPools.size(); ++memoryPoolId)
+        {
+            if (IsPoolWithinGuarantee(memoryPoolId))
+                return true;
+        }
+
+        return false;
+    }
+
+    bool TiledTextureManagerImpl::EvictTextureStandbyTile(uint32_t textureId)
+    {
+        TiledTextureState& tiledTextureState = m_tiledTextures[textureId];
+        if (!tiledTextureState.standbyUnpackedTilesNum)
+            return false;
+
+        // The least recently requested standby tile of the texture is the first one which entered standby
+        return TransitionTile(textureId, tiledTextureState.standbyQueue.front(), TileState_Free);
+    }
+
+    bool TiledTextureManagerImpl::EnforceActiveQuota(uint32_t textureId, uint32_t tileIndex)
+    {
+        TiledTextureState& tiledTextureState = m_tiledTextures[textureId];
+        const TiledTextureSharedDesc& desc = m_tiledTextureSharedDescs[tiledTextureState.descIndex];
+
+        // Packed tiles are required for sampling the texture and are not limited by quotas
+        if (tileIndex >= desc.regularTilesNum)
+            return true;
+
+        // Make room for the new tile by evicting the pool's, texture's or category's own standby tiles
+        MemoryPoolState& memoryPool = GetMemoryPool(tiledTextureState.poolId);
+        while (memoryPool.allocatedTilesNum >= memoryPool.desc.maxTilesNum)
+        {
+            if (memoryPool.standbyQueue.size() == 0)
+                return false;
+
+            TextureAndTile textureAndTile = memoryPool.standbyQueue.front();
+            TransitionTile(textureAndTile.textureId, textureAndTile.tileIndex, TileState_Free);
+        }
+
+        while (tiledTextureState.allocatedUnpackedTilesNum >= tiledTextureState.quota.maxActiveTilesNum)
+        {
+            if (!EvictTextureStandbyTile(textureId))
+                return false;
+        }
+
+        if (tiledTextureState.categoryId)
+        {
+            TileCategoryState& tileCategory = GetTileCategory(tiledTextureState.categoryId);
+            while (tileCategory.allocatedTilesNum >= tileCategory.quota.maxActiveTilesNum)
+            {
+                if (tileCategory.standbyQueue.size() == 0)
+                    return false;
+
+                TextureAndTile textureAndTile = tileCategory.standbyQueue.front();
+                TransitionTile(textureAndTile.textureId, textureAndTile.tileIndex, TileState_Free);
+            }
+        }
+
         return true;
     }
 
+    void TiledTextureManagerImpl::EnforceStandbyQuota(uint32_t textureId)
+    {
+        TiledTextureState& tiledTextureState = m_tiledTextures[textureId];
+
+        MemoryPoolState& memoryPool = GetMemoryPool(tiledTextureState.poolId);
+        while (memoryPool.standbyQueue.size() > memoryPool.desc.maxStandbyTilesNum)
+        {
+            TextureAndTile textureAndTile = memoryPool.standbyQueue.front();
+            TransitionTile(textureAndTile.textureId, textureAndTile.tileIndex, TileState_Free);
+        }
+
+        while (tiledTextureState.standbyUnpackedTilesNum > tiledTextureState.quota.maxStandbyTilesNum)
+            EvictTextureStandbyTile(textureId);
+
+        if (tiledTextureState.categoryId)
+        {
+            TileCategoryState& tileCategory = GetTileCategory(tiledTextureState.categoryId);
+            while (tileCategory.standbyQueue.size() > tileCategory.quota.maxStandbyTilesNum)
+            {
+                TextureAndTile textureAndTile = tileCategory.standbyQueue.front();
+                TransitionTile(textureAndTile.textureId, textureAndTile.tileIndex, TileState_Free);
+            }
+        }
+    }
+
     TiledTextureManager* CreateTiledTextureManager(const TiledTextureManagerDesc& desc)
     {
         return new TiledTextureManagerImpl(desc);
     }
+
+    SharedTileAllocator* CreateSharedTileAllocator(TilePlacementPolicy tilePlacementPolicy)
+    {
+        return new TileAllocator(65536, tilePlacementPolicy);
+    }
+
+    TiledTextureManager* CreateTiledTextureManager(const TiledTextureManagerDesc& desc, SharedTileAllocator* pSharedTileAllocator)
+    {
+        return new TiledTextureManagerImpl(desc, static_cast<TileAllocator*>(pSharedTileAllocator));
+    }
 } // rtxts
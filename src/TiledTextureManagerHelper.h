@@ -13,12 +13,27 @@
 #pragma once
 
 #include <vector>
+#include <algorithm>
 #include <iterator>
-#include <list>
 #include <unordered_map>
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 namespace rtxts
 {
+    inline uint32_t CountTrailingZeros(uint64_t value)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward64(&index, value);
+        return (uint32_t)index;
+#else
+        return (uint32_t)__builtin_ctzll(value);
+#endif
+    }
+
     class BitArray
     {
     public:
@@ -29,7 +44,7 @@ namespace rtxts
             using difference_type = std::uint32_t;
             using value_type = uint32_t;
 
-            SetBitIterator(BitArray* pBits, uint32_t index, bool recede = false) :
+            SetBitIterator(const BitArray* pBits, uint32_t index, bool recede = false) :
                 m_pBits(pBits),
                 m_index(index)
             {
@@ -37,8 +52,7 @@ namespace rtxts
                     while (ShouldRecede())
                         --m_index;
                 else
-                    while (ShouldAdvance())
-                        ++m_index;
+                    m_index = m_pBits->FindNextSetBit(m_index);
             }
 
             value_type operator*() const { return m_index; }
@@ -46,10 +60,7 @@ namespace rtxts
             SetBitIterator& operator++()
             {
                 if (m_index < m_pBits->m_bitsNum)
-                    ++m_index;
-
-                while (ShouldAdvance())
-                    ++m_index;
+                    m_index = m_pBits->FindNextSetBit(m_index + 1);
 
                 return *this;
             }
@@ -71,17 +82,12 @@ namespace rtxts
             friend bool operator!= (const SetBitIterator& a, const SetBitIterator& b) { return a.m_pBits != b.m_pBits || a.m_index != b.m_index; };
 
         private:
-            bool ShouldAdvance()
-            {
-                return m_index < m_pBits->m_bitsNum && !m_pBits->GetBit(m_index);
-            }
-
             bool ShouldRecede()
             {
                 return m_index >= 0 && m_index != UINT32_MAX && !m_pBits->GetBit(m_index);
             }
 
-            BitArray* m_pBits;
+            const BitArray* m_pBits;
             uint32_t m_index;
         };
 
@@ -102,10 +108,16 @@ namespace rtxts
         void Init(uint32_t numbits)
         {
             m_bitsNum = numbits;
-            m_wordsNum = ((m_bitsNum - 1) / 64) + 1;
+            m_wordsNum = (m_bitsNum + 63) / 64;
             m_words.resize(m_wordsNum);
         }
 
+        // Preallocate storage so Init() doesn't allocate up to the given number of bits
+        void Reserve(uint32_t numbits)
+        {
+            m_words.reserve((numbits + 63) / 64);
+        }
+
         void Clear()
         {
             std::fill(m_words.begin(), m_words.end(), 0);
@@ -176,6 +188,47 @@ namespace rtxts
             return m_words[index >> 6] & mask;
         }
 
+        // Returns the index of the first set bit at or after index, or the number of bits if there is none
+        uint32_t FindNextSetBit(uint32_t index) const
+        {
+            if (index >= m_bitsNum)
+                return m_bitsNum;
+
+            uint32_t wordIndex = index >> 6;
+            uint64_t word = m_words[wordIndex] & (~0ui64 << (index & 63));
+            while (!word)
+            {
+                if (++wordIndex >= m_wordsNum)
+                    return m_bitsNum;
+                word = m_words[wordIndex];
+            }
+
+            return std::min(m_bitsNum, (wordIndex << 6) + CountTrailingZeros(word));
+        }
+
+        // Returns the index of the first clear bit at or after index, or the number of bits if there is none
+        uint32_t FindNextClearBit(uint32_t index) const
+        {
+            if (index >= m_bitsNum)
+                return m_bitsNum;
+
+            uint32_t wordIndex = index >> 6;
+            uint64_t word = ~m_words[wordIndex] & (~0ui64 << (index & 63));
+            while (!word)
+            {
+                if (++wordIndex >= m_wordsNum)
+                    return m_bitsNum;
+                word = ~m_words[wordIndex];
+            }
+
+            return std::min(m_bitsNum, (wordIndex << 6) + CountTrailingZeros(word));
+        }
+
+        uint32_t GetBitsNum() const
+        {
+            return m_bitsNum;
+        }
+
         uint32_t BitCount()
         {
             uint32_t bitCount = 0;
@@ -193,22 +246,22 @@ namespace rtxts
             return true;
         }
 
-        SetBitIterator begin()
+        SetBitIterator begin() const
         {
             return SetBitIterator(this, 0);
         }
 
-        SetBitIterator end()
+        SetBitIterator end() const
         {
             return SetBitIterator(this, m_bitsNum);
         }
 
-        SetBitIterator rbegin()
+        SetBitIterator rbegin() const
         {
             return SetBitIterator(this, m_bitsNum - 1, true);
         }
 
-        SetBitIterator rend()
+        SetBitIterator rend() const
         {
             return SetBitIterator(this, -1, true);
         }
@@ -219,56 +272,261 @@ namespace rtxts
         std::vector<uint64_t> m_words;
     };
 
+    // Open addressing hash map with linear probing for small keys and values, it doesn't allocate once it has reached its peak size or was reserved
+    template <typename Key, typename Value, typename Hash = std::hash<Key>>
+    class FlatHashMap
+    {
+    public:
+        // Preallocate storage so the map doesn't allocate up to the given number of entries
+        void Reserve(size_t size)
+        {
+            size_t entriesNum = 16;
+            while (entriesNum < size * 2)
+                entriesNum <<= 1;
+            if (entriesNum > m_entries.size())
+                Rehash(entriesNum);
+        }
+
+        Value* find(const Key& key)
+        {
+            size_t index = FindIndex(key);
+            return index != InvalidIndex ? &m_entries[index].value : nullptr;
+        }
+
+        const Value* find(const Key& key) const
+        {
+            size_t index = FindIndex(key);
+            return index != InvalidIndex ? &m_entries[index].value : nullptr;
+        }
+
+        const Value& at(const Key& key) const
+        {
+            return *find(key);
+        }
+
+        // Inserts the key or replaces its value
+        void insert(const Key& key, const Value& value)
+        {
+            Value* pValue = find(key);
+            if (pValue)
+            {
+                *pValue = value;
+                return;
+            }
+
+            if ((m_size + 1) * 2 > m_entries.size())
+                Rehash(std::max<size_t>(16, m_entries.size() * 2));
+
+            InsertEntry(key, value);
+            m_size++;
+        }
+
+        void erase(const Key& key)
+        {
+            size_t index = FindIndex(key);
+            if (index == InvalidIndex)
+                return;
+
+            // Shift back the following entries of the probe sequence so lookups don't stop at the hole
+            size_t mask = m_entries.size() - 1;
+            size_t hole = index;
+            for (size_t next = (hole + 1) & mask; m_entries[next].isUsed; next = (next + 1) & mask)
+            {
+                size_t home = HomeIndex(m_entries[next].key);
+                if (((next - home) & mask) >= ((next - hole) & mask))
+                {
+                    m_entries[hole] = m_entries[next];
+                    hole = next;
+                }
+            }
+            m_entries[hole].isUsed = false;
+            m_size--;
+        }
+
+        size_t size() const
+        {
+            return m_size;
+        }
+
+        // Calls func(key, value) for every entry
+        template <typename Func>
+        void ForEach(Func func) const
+        {
+            for (auto& entry : m_entries)
+            {
+                if (entry.isUsed)
+                    func(entry.key, entry.value);
+            }
+        }
+
+    private:
+        static const size_t InvalidIndex = SIZE_MAX;
+
+        struct Entry
+        {
+            Key key;
+            Value value;
+            bool isUsed;
+        };
+
+        size_t HomeIndex(const Key& key) const
+        {
+            // Fibonacci hashing spreads keys whose hash only differs in the high bits
+            return (size_t)((uint64_t(Hash()(key)) * 0x9E3779B97F4A7C15ull) >> m_shift);
+        }
+
+        size_t FindIndex(const Key& key) const
+        {
+            if (!m_size)
+                return InvalidIndex;
+
+            size_t mask = m_entries.size() - 1;
+            for (size_t index = HomeIndex(key);; index = (index + 1) & mask)
+            {
+                if (!m_entries[index].isUsed)
+                    return InvalidIndex;
+                if (m_entries[index].key == key)
+                    return index;
+            }
+        }
+
+        void InsertEntry(const Key& key, const Value& value)
+        {
+            size_t mask = m_entries.size() - 1;
+            size_t index = HomeIndex(key);
+            while (m_entries[index].isUsed)
+                index = (index + 1) & mask;
+            m_entries[index] = Entry{key, value, true};
+        }
+
+        void Rehash(size_t entriesNum)
+        {
+            std::vector<Entry> entries(entriesNum, Entry{Key(), Value(), false});
+            entries.swap(m_entries);
+
+            m_shift = 64;
+            for (size_t n = entriesNum; n > 1; n >>= 1)
+                m_shift--;
+
+            for (auto& entry : entries)
+            {
+                if (entry.isUsed)
+                    InsertEntry(entry.key, entry.value);
+            }
+        }
+
+        std::vector<Entry> m_entries; // The number of entries is a power of 2
+        uint32_t m_shift = 64;
+        size_t m_size = 0;
+    };
+
     // Least-Recently-Used container for caching tiles
+    // Nodes live in a pool indexed by a flat hash map, so the queue doesn't allocate once it has reached its peak size or was reserved
     template <typename T, typename Hash>
     class LRUQueue {
     private:
-        std::list<T> list;
-        std::unordered_map<T, typename std::list<T>::iterator, Hash> map;
+        enum : uint32_t { InvalidIndex = UINT32_MAX };
+
+        struct Node
+        {
+            T val;
+            uint32_t prev;
+            uint32_t next;
+        };
+
+        std::vector<Node> nodes;
+        FlatHashMap<T, uint32_t, Hash> map;
+        uint32_t head = InvalidIndex;
+        uint32_t tail = InvalidIndex;
+        uint32_t freeHead = InvalidIndex;
+
+        void Unlink(uint32_t nodeIndex)
+        {
+            Node& node = nodes[nodeIndex];
+            if (node.prev != InvalidIndex)
+                nodes[node.prev].next = node.next;
+            else
+                head = node.next;
+            if (node.next != InvalidIndex)
+                nodes[node.next].prev = node.prev;
+            else
+                tail = node.prev;
+
+            node.next = freeHead;
+            freeHead = nodeIndex;
+        }
 
     public:
+        // Preallocate storage for the given number of elements
+        void Reserve(size_t size)
+        {
+            nodes.reserve(size);
+            map.Reserve(size);
+        }
+
         void push_back(const T& val)
-        {  
-            list.push_back(val);
-            map[val] = --list.end();
+        {
+            uint32_t nodeIndex = freeHead;
+            if (nodeIndex != InvalidIndex)
+            {
+                freeHead = nodes[nodeIndex].next;
+            }
+            else
+            {
+                nodeIndex = (uint32_t)nodes.size();
+                nodes.push_back(Node());
+            }
+
+            Node& node = nodes[nodeIndex];
+            node.val = val;
+            node.prev = tail;
+            node.next = InvalidIndex;
+            if (tail != InvalidIndex)
+                nodes[tail].next = nodeIndex;
+            else
+                head = nodeIndex;
+            tail = nodeIndex;
+
+            map.insert(val, nodeIndex);
         }
 
         void pop_front()
         {
-            if (!list.empty())
+            if (head != InvalidIndex)
             {
-                map.erase(list.front());
-                list.pop_front();
+                map.erase(nodes[head].val);
+                Unlink(head);
             }
         }
 
         const T& front() const
         {
-            return list.front();
+            return nodes[head].val;
         }
 
         bool contains(const T& val) const
         {
-            return map.find(val) != map.end();
+            return map.find(val) != nullptr;
         }
 
         void erase(const T& val)
         {
-            auto it = map.find(val);
-            if (it != map.end())
+            const uint32_t* pNodeIndex = map.find(val);
+            if (pNodeIndex)
             {
-                list.erase(it->second);
-                map.erase(it);
+                uint32_t nodeIndex = *pNodeIndex;
+                map.erase(val);
+                Unlink(nodeIndex);
             }
         }
 
         size_t size() const
         {
-            return list.size();
+            return map.size();
         }
     };
 
-    static uint32_t PrevPowerOf2(uint32_t x)
+    inline uint32_t PrevPowerOf2(uint32_t x)
     {
         x = x | (x >> 1);
         x = x | (x >> 2);
@@ -278,7 +536,7 @@ namespace rtxts
         return x - (x >> 1);
     }
 
-    static uint32_t RoundUp(uint32_t value, uint32_t alignment)
+    inline uint32_t RoundUp(uint32_t value, uint32_t alignment)
     {
         return ((value + (alignment - 1)) / alignment) * alignment;
     }
@@ -62,8 +62,10 @@ namespace rtxts
     // Tile state which implements a state machine for the tile
     // Valid state transitions:
     // Free -> Requested
+    // Free -> Allocated (constant tiles)
     // Requested -> Allocated
     // Allocated -> Mapped
+    // Allocated -> Free (when its heap is removed)
     // Mapped -> Free
     // Mapped -> Standby
     // Standby -> Free
@@ -87,11 +89,65 @@ namespace rtxts
         std::vector<TileAllocation> tileAllocations;
         std::vector<uint32_t> tilesToMap;
         std::vector<uint32_t> tilesToUnmap;
+        std::vector<uint32_t> tilesToMapFront; // tilesToMap handed out by GetTilesToMapSpan()
+        std::vector<uint32_t> tilesToUnmapFront; // tilesToUnmap handed out by GetTilesToUnmapSpan()
+        bool hasPendingWork = false; // listed in m_texturesWithPendingWork
 
         std::vector<TileState> tileStates;
 
         uint32_t requestedTilesNum = 0; // number of tiles currently being requested by sampler feedback
         BitArray requestedBits; // tiles which are currently being actively requested (for MatchPrimaryTexture)
+
+        std::vector<uint64_t> contentHashes; // Content hash per tile for deduplication, empty until a hash is set
+        std::vector<uint32_t> constantTileIds; // Constant tile per regular tile or UINT32_MAX, empty until a tile is flagged constant
+        uint32_t constantTilesNum = 0; // number of tiles holding the allocation of a constant tile
+
+        uint32_t categoryId = 0;
+        uint32_t poolId = 0;
+        uint32_t standbyUnpackedTilesNum = 0;
+        LRUQueue<uint32_t, std::hash<uint32_t>> standbyQueue; // Regular tiles of the texture which are currently in standby
+        TileQuota quota;
+
+        // Heap and heap tile following the last tile allocated for this texture, used for texture-affinity placement
+        HeapHandle affinityHeap = InvalidHeapHandle;
+        uint32_t affinityHeapTileIndex = 0;
+    };
+
+    // Tile accounting for a user-defined texture category
+    struct TileCategoryState
+    {
+        TileQuota quota;
+        uint32_t allocatedTilesNum = 0; // number of regular tiles holding an allocation in all textures of the category
+
+        LRUQueue<TextureAndTile, TextureAndTileHash> standbyQueue; // Regular tiles of the category which are currently in standby
+    };
+
+    // Tile accounting for a memory pool
+    struct MemoryPoolState
+    {
+        MemoryPoolDesc desc;
+        uint32_t allocatedTilesNum = 0; // number of heap tiles held by all textures of the pool, including packed tiles, a shared heap tile counts for the pool of its first tile
+
+        LRUQueue<TextureAndTile, TextureAndTileHash> standbyQueue; // Tiles of the pool which are currently in standby
+        LRUQueue<TextureAndTile, TextureAndTileHash> mappedQueue; // Regular tiles of the pool which are currently mapped, in the order they were mapped
+    };
+
+    // Heap tile shared by all allocated tiles with the same content hash
+    struct SharedTileState
+    {
+        TileAllocation allocation;
+        std::vector<TextureAndTile> tiles; // The heap tile is registered for the first tile in the allocator
+    };
+
+    // Smoothed heap demand and the capacity decisions derived from it
+    struct HeapPlannerState
+    {
+        bool isInitialized = false;
+        float demandLevel = 0.0f;
+        float demandTrend = 0.0f;
+        float lastStepTime = 0.0f;
+        float lastChangeTime = 0.0f;
+        uint32_t desiredTilesNum = 0;
     };
 
     class TiledTextureManagerImpl : public TiledTextureManager
@@ -99,63 +155,150 @@ namespace rtxts
     public:
         ~TiledTextureManagerImpl() override;
 
-        TiledTextureManagerImpl(const TiledTextureManagerDesc& desc);
+        TiledTextureManagerImpl(const TiledTextureManagerDesc& desc, TileAllocator* pSharedTileAllocator = nullptr);
 
         void SetConfig(const TiledTextureManagerConfig& config) override;
 
-        void AddTiledTexture(const TiledTextureDesc& tiledTextureDesc, uint32_t& textureId) override;
+        TiledTextureManagerResult AddTiledTexture(const TiledTextureDesc& tiledTextureDesc, uint32_t& textureId) override;
         void RemoveTiledTexture(uint32_t textureId) override;
 
+        void SetTextureCategory(uint32_t textureId, uint32_t categoryId) override;
+        void SetTextureQuota(uint32_t textureId, const TileQuota& quota) override;
+        void SetCategoryQuota(uint32_t categoryId, const TileQuota& quota) override;
+        void SetMemoryPool(uint32_t poolId, const MemoryPoolDesc& memoryPoolDesc) override;
+
         void UpdateWithSamplerFeedback(uint32_t textureId, SamplerFeedbackDesc& samplerFeedbackDesc, float timestamp, float timeout) override;
         void MatchPrimaryTexture(uint32_t primaryTextureId, uint32_t followerTextureId, float timeStamp, float timeout) override;
 
         uint32_t GetNumDesiredHeaps() override;
+        HeapPlan GetHeapPlan() override;
+        void GetDesiredHeapCapacities(std::vector<uint32_t>& heapTilesNums) override;
 
-        void AddHeap(uint32_t heapId) override;
+        TiledTextureManagerResult AddHeap(uint32_t heapId, uint32_t heapTilesNum) override;
         void RemoveHeap(uint32_t heapId) override;
+        TiledTextureManagerResult ReserveHeap(uint32_t heapId, uint32_t heapTilesNum) override;
+        void CommitHeap(uint32_t heapId) override;
+
+        bool BeginEvacuateHeap(uint32_t heapId, std::vector<TileMove>& tileMoves) override;
+        void CancelEvacuateHeap(uint32_t heapId) override;
+        void CompleteTileMoves(const std::vector<TileMove>& tileMoves) override;
 
         void TrimStandbyTiles() override;
+        void SetMemoryBudget(uint64_t budgetInBytes) override;
+        void EmergencyTrim(uint64_t bytesToFree, std::vector<uint32_t>& heapIds) override;
 
         void AllocateRequestedTiles() override;
 
         void GetTilesToMap(uint32_t textureId, std::vector<uint32_t>& tileIndices) override;
-        void UpdateTilesMapping(uint32_t textureId, std::vector<uint32_t>& tileIndices) override;
+        void UpdateTilesMapping(uint32_t textureId, const std::vector<uint32_t>& tileIndices) override;
+        void UpdateTilesMapping(uint32_t textureId, Span<uint32_t> tileIndices) override;
         void GetTilesToUnmap(uint32_t textureId, std::vector<uint32_t>& tileIndices) override;
+        Span<uint32_t> GetTilesToMapSpan(uint32_t textureId) override;
+        Span<uint32_t> GetTilesToUnmapSpan(uint32_t textureId) override;
+        void GetTileRangesToMap(uint32_t textureId, std::vector<TileRange>& tileRanges) override;
+        void UpdateTilesMapping(uint32_t textureId, const std::vector<TileRange>& tileRanges) override;
+        void GetTileRangesToUnmap(uint32_t textureId, std::vector<TileRange>& tileRanges) override;
+        void GetTexturesWithPendingWork(std::vector<uint32_t>& textureIds) override;
+        const std::vector<TileBinding>& BuildTileBindings() override;
+        void UpdateTilesMapping(const std::vector<TileBinding>& tileBindings) override;
 
         void WriteMinMipData(uint32_t textureId, uint8_t* data) override;
 
         void DefragmentTiles(uint32_t numTiles) override;
+        void DefragmentTiles(uint32_t numTiles, std::vector<TileMove>& tileMoves) override;
+        void PlanDefragmentation(uint32_t maxHeapsNum, uint32_t maxMovesNum, std::vector<TileMove>& tileMoves) override;
 
         void GetEmptyHeaps(std::vector<uint32_t>& emptyHeaps) override;
 
         TextureDesc GetTextureDesc(uint32_t textureId, TextureTypes textureType) const override;
+        void SetTileContentHash(uint32_t textureId, uint32_t tileIndex, uint64_t contentHash) override;
+        void SetConstantTile(uint32_t constantTileId, const TileAllocation& tileAllocation) override;
+        void SetTileConstant(uint32_t textureId, uint32_t tileIndex, uint32_t constantTileId) override;
+        bool IsSharedTile(uint32_t textureId, uint32_t tileIndex) const override;
         bool IsMovableTile(uint32_t textureId, uint32_t tileIndex) const override;
 
         const std::vector<TileCoord>& GetTileCoordinates(uint32_t textureId) const override;
         const std::vector<TileAllocation>& GetTileAllocations(uint32_t textureId) const override;
 
         Statistics GetStatistics() const override;
+        void GetExtendedStatistics(ExtendedStatistics& statistics) const override;
+        MemoryPoolStatistics GetMemoryPoolStatistics(uint32_t poolId) const override;
 
     private:
         void InitTiledTexture(uint32_t textureId, const TiledTextureDesc& tiledTextureDesc);
-        void UpdateTiledTexture(uint32_t textureId, BitArray requestedBits, uint32_t firstTileIndex, float timeStamp, float timeout);
+        void UpdateTiledTexture(uint32_t textureId, const BitArray& requestedBits, uint32_t firstTileIndex, float timeStamp, float timeout);
+        void ResetTiledTextureState(TiledTextureState& tiledTextureState);
 
         uint32_t GetTileIndex(const TiledTextureSharedDesc& tiledTextureDesc, const TileCoord& tileCoord) const;
+        void ReconcilePendingTiles(TiledTextureState& tiledTextureState);
+        void BuildTileRanges(const TiledTextureState& tiledTextureState, std::vector<uint32_t>& tileIndices, bool useAllocations, std::vector<TileRange>& tileRanges) const;
+        uint32_t GetDesiredTilesNum() const;
+        TileLifetimeClass GetTileLifetimeClass(const TiledTextureSharedDesc& tiledTextureDesc, uint32_t tileIndex) const;
 
         bool TransitionTile(uint32_t textureId, uint32_t tileIndex, TileState newState);
+        void MarkPendingWork(uint32_t textureId);
+        void UpdateTexturesWithPendingWork();
+        bool IsConstantTile(const TiledTextureState& tiledTextureState, uint32_t tileIndex) const;
+
+        TileCategoryState& GetTileCategory(uint32_t categoryId);
+        MemoryPoolState& GetMemoryPool(uint32_t poolId);
+        bool FindPoolStandbyTile(uint32_t poolId, bool ignoreGuarantees, TextureAndTile& evictTile, float& evictTileTime) const;
+        bool EvictStandbyTile(uint32_t poolId, bool ignoreGuarantees = false);
+        void EvictMappedTiles(uint32_t tilesNum, bool borrowedTilesOnly = false);
+        bool IsPoolBorrowing(uint32_t poolId) const;
+        bool IsPoolWithinGuarantee(uint32_t poolId) const;
+        bool HasPoolWithinGuarantee() const;
+        void ReleaseHeapTiles(uint32_t heapId, bool standbyOnly = false);
+        void ReleaseHeapTile(uint32_t heapId, const TextureAndTile& textureAndTile, bool standbyOnly);
+        void ReleaseTile(const TextureAndTile& textureAndTile);
+        SharedTileState* FindSharedTile(uint32_t textureId, uint32_t tileIndex);
+        void FreeSharedTile(uint32_t textureId, uint32_t tileIndex);
+        void UpdateSharedTileAllocation(SharedTileState& sharedTile, const TileAllocation& tileAllocation);
+        bool EvictTextureStandbyTile(uint32_t textureId);
+        bool EnforceActiveQuota(uint32_t textureId, uint32_t tileIndex);
+        void EnforceStandbyQuota(uint32_t textureId);
+        void CancelTileMove(uint32_t textureId, uint32_t tileIndex);
 
         std::shared_ptr<TileAllocator> m_tileAllocator;
+        uint32_t m_ownerId; // Owner id of this manager in the tile allocator
         const TiledTextureManagerDesc m_tiledTextureManagerDesc;
         TiledTextureManagerConfig m_config;
 
         std::vector<TiledTextureState> m_tiledTextures;
         std::vector<TiledTextureSharedDesc> m_tiledTextureSharedDescs;
         std::vector<uint32_t> m_tiledTextureFreelist;
+        std::vector<uint32_t> m_texturesWithPendingWork; // Textures which had tiles added to tilesToMap or tilesToUnmap, may include textures whose lists were emptied since
+        std::vector<TileCategoryState> m_tileCategories;
+        std::vector<MemoryPoolState> m_memoryPools;
 
         LRUQueue<TextureAndTile, TextureAndTileHash> m_requestedQueue; // Tiles which are waiting to be allocated
         LRUQueue<TextureAndTile, TextureAndTileHash> m_standbyQueue; // Tiles which are currently in standby
+        FlatHashMap<TextureAndTile, TileAllocation, TextureAndTileHash> m_pendingTileMoves; // Destination allocations of tiles being moved
+        LRUQueue<TextureAndTile, TextureAndTileHash> m_reservedHeapTiles; // Tiles allocated in reserved heaps, held back from mapping until their heap is committed
+        std::unordered_map<uint64_t, SharedTileState> m_sharedTiles; // Heap tiles of deduplicated tiles by content hash
+        uint32_t m_sharedTilesNum = 0; // Number of allocated tiles using the heap tile of another tile
+        std::vector<TileAllocation> m_constantTiles; // Prefilled heap tiles of the application for tiles with a constant value
 
         uint32_t m_totalTilesNum; // Total number of tiles in all textures
         uint32_t m_activeTilesNum; // Total number of active (requested+allocated) tiles in all textures
+        uint32_t m_requestedTilesNum = 0; // Total number of requested tiles in all textures
+        float m_latestTimeStamp = 0.0f; // Latest timestamp textures were updated with
+
+        HeapPlannerState m_heapPlanner;
+
+        std::vector<TileBinding> m_tileBindings[2]; // Double-buffered binding command stream
+        uint32_t m_tileBindingsIndex = 0; // Buffer returned by the latest BuildTileBindings()
+
+        // Scratch storage reused across calls
+        BitArray m_requestedBits; // Tiles requested by sampler feedback
+        TiledTextureSharedDesc m_newSharedDesc; // Descriptor of a texture being added
+        std::vector<std::pair<uint32_t, TextureAndTile>> m_heapTiles; // Owners and tiles of a heap being released
+        std::vector<TileRange> m_tileRanges; // Ranges of a texture added to the binding command stream
+        std::vector<TextureAndTile> m_sharedTilesScratch; // Tiles sharing a heap tile which is being released
+        std::vector<uint32_t> m_moveHeapIds; // Heaps emptied by a defragmentation
+        std::vector<TextureAndTile> m_moveTiles; // Tiles moved by a defragmentation or an evacuation
+        std::vector<TileLifetimeClass> m_moveLifetimeClasses; // Lifetime classes of the moved tiles
+        std::vector<TileAllocation> m_moveDstAllocations; // Destination allocations of the moved tiles
+        BitArray m_pendingTileBits; // Tiles of a texture with a pending map
     };
 } // rtxts